@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Convert assembled standard library variants into C++ header with their code
+and symbol tables, which is compiled into backend.
+
+Usage: embed_stdlib.py <output header> <variant>:<name>...
+
+Each <name> refers to '<name>.bin' and '<name>.map' produced by NASM
+(see 'make stdlib').
+"""
+
+import re
+import sys
+
+HEADER = """\
+/**
+ * @file stdlib_image.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief Prebuilt standard library variants and their symbol tables
+ *
+ * Generated by 'assets/embed_stdlib.py' from 'assets/stdlib*.asm', do not
+ * edit manually. Run 'make stdlib' after changing standard library sources.
+ */
+#ifndef __COMPILER_STDLIB_IMAGE_H
+#define __COMPILER_STDLIB_IMAGE_H
+
+#include <stddef.h>
+
+/**
+ * @brief Label of standard library binary
+ */
+struct stdlib_symbol
+{
+    const char* name;
+    size_t      offset;     // Offset from the start of binary
+};
+
+/**
+ * @brief Standard library binary with its labels sorted by offset
+ */
+struct stdlib_image
+{
+    const unsigned char* code;
+    size_t               size;
+    const stdlib_symbol* symbols;
+    size_t               symbol_cnt;
+};
+"""
+
+FOOTER = """
+#endif /* stdlib_image.h */
+"""
+
+SYMBOL_LINE = re.compile(r"^\s*([0-9A-Fa-f]+)\s+([0-9A-Fa-f]+)\s+(\S+)\s*$")
+
+
+def read_symbols(map_filename, code_size):
+    """
+    Read labels from 'Symbols' part of NASM map file, skipping local labels
+    other than '.shift_ref' and constants outside of binary.
+    """
+    symbols = []
+    with open(map_filename) as map_file:
+        for line in map_file:
+            match = SYMBOL_LINE.match(line)
+            if not match:
+                continue
+            offset = int(match.group(2), 16)
+            name = match.group(3)
+            if "." in name and not name.endswith(".shift_ref"):
+                continue
+            if offset > code_size:
+                continue
+            symbols.append((offset, name))
+    return sorted(symbols)
+
+
+def write_variant(out, variant, name):
+    with open(name + ".bin", "rb") as bin_file:
+        code = bin_file.read()
+    symbols = read_symbols(name + ".map", len(code))
+
+    out.write("\n// %s\n" % (name + ".asm").split("/")[-1])
+    out.write("static constexpr unsigned char stdlib_%s_code[] = {\n" % variant)
+    for start in range(0, len(code), 12):
+        chunk = code[start:start + 12]
+        out.write("    " + ", ".join("0x%02X" % byte for byte in chunk)
+                  + ",\n")
+    out.write("};\n\n")
+
+    out.write("static constexpr stdlib_symbol stdlib_%s_symbols[] = {\n"
+              % variant)
+    for offset, symbol in symbols:
+        out.write("    { %-22s 0x%03X },\n" % ('"%s",' % symbol, offset))
+    out.write("};\n\n")
+
+    out.write("static constexpr stdlib_image stdlib_%s = {\n" % variant)
+    out.write("    .code       = stdlib_%s_code,\n" % variant)
+    out.write("    .size       = sizeof(stdlib_%s_code),\n" % variant)
+    out.write("    .symbols    = stdlib_%s_symbols,\n" % variant)
+    out.write("    .symbol_cnt = sizeof(stdlib_%s_symbols)\n" % variant)
+    out.write("                / sizeof(*stdlib_%s_symbols)\n" % variant)
+    out.write("};\n")
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+
+    with open(sys.argv[1], "w") as out:
+        out.write(HEADER)
+        for arg in sys.argv[2:]:
+            variant, name = arg.split(":", 1)
+            write_variant(out, variant, name)
+        out.write(FOOTER)
+
+
+if __name__ == "__main__":
+    main()
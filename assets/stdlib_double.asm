@@ -0,0 +1,256 @@
+; Standard library for double-precision numbers (--float)
+;
+; Numbers are passed and returned as IEEE-754 doubles. Input and output use
+; the same decimal format as default library: integer x * 1000.
+
+; Output is collected in buffer below global variables and written when
+; buffer is full, or by 'print_flush' at program exit. Unless
+; 'OUT_UNBUFFERED' byte is set by compiler, in which case every number is
+; written immediately.
+OUT_LEN		equ		0x5DF000
+OUT_UNBUFFERED	equ		0x5DF008
+OUT_BUF		equ		0x5F0000
+OUT_BUF_SIZE	equ		0x10000
+
+; Input is read into buffer in large chunks, and unparsed part of it is kept
+; between 'read_num' calls in [IN_POS; IN_END).
+IN_POS		equ		0x5DF010
+IN_END		equ		0x5DF018
+IN_BUF		equ		0x5E0000
+IN_BUF_SIZE	equ		0x10000
+
+; Compiler links routines 'print_num', 'read_num' and 'sqrt' separately,
+; each one spanning until the next of them or 'stdlib_end'. Their offsets are
+; taken from map file by 'make stdlib'.
+[map symbols stdlib_double.map]
+
+section .text
+
+print_num:	push		rbp
+		mov		rbp,		rsp
+		sub		rsp,		32
+
+		movsd		xmm0,	QWORD	[rbp + 16]
+		mov		eax,		1000
+		cvtsi2sd	xmm1,		rax
+		mulsd		xmm0,		xmm1
+		cvtsd2si	rax,		xmm0		; Rounded x * 1000 in rax
+
+		xor		r8,		r8		; Sign flag in r8
+		test		rax,		rax
+		jge		.convert
+		neg		rax
+		inc		r8
+
+.convert:	lea		r9,		[rel digit_pairs]	; Two-digit table in r9
+		lea		rdi,		[rbp - 1]	; Start of text in rdi
+		mov	BYTE	[rdi],		0x0A		; Terminate with '\n'
+
+		mov		rsi,		rax
+		shr		rax,		3
+		mov		rdx,		0x20C49BA5E353F7CF	; 2^68 / 1000
+		mul		rdx
+		shr		rdx,		4		; Integer part in rdx
+		imul		rax,		rdx,		1000
+		sub		rsi,		rax		; Fraction in rsi
+		mov		rax,		rdx		; Integer part in rax
+
+		imul		ecx,		esi,		41	; Fraction / 100 in rcx
+		shr		ecx,		12
+		imul		edx,		ecx,		100
+		sub		esi,		edx
+		movzx		edx,	WORD	[r9 + rsi*2]
+		sub		rdi,		2
+		mov	WORD	[rdi],		dx
+		add		cl,		0x30		; '0'
+		dec		rdi
+		mov	BYTE	[rdi],		cl
+		dec		rdi
+		mov	BYTE	[rdi],		0x2E		; '.'
+
+.int_pairs:	cmp		rax,		100
+		jb		.int_last
+		mov		rsi,		rax
+		shr		rax,		2
+		mov		rdx,		0x28F5C28F5C28F5C3	; 2^66 / 100
+		mul		rdx
+		shr		rdx,		2		; Quotient in rdx
+		imul		rax,		rdx,		100
+		sub		rsi,		rax		; Last two digits in rsi
+		mov		rax,		rdx
+		movzx		edx,	WORD	[r9 + rsi*2]
+		sub		rdi,		2
+		mov	WORD	[rdi],		dx
+		jmp		.int_pairs
+
+.int_last:	cmp		rax,		10
+		jb		.int_digit
+		movzx		edx,	WORD	[r9 + rax*2]
+		sub		rdi,		2
+		mov	WORD	[rdi],		dx
+		jmp		.sign
+
+.int_digit:	add		al,		0x30		; '0'
+		dec		rdi
+		mov	BYTE	[rdi],		al
+
+.sign:		test		r8,		r8
+		jz		.print
+		dec		rdi
+		mov	BYTE	[rdi],		0x2D		; '-'
+
+.print:		mov		rcx,		rbp
+		sub		rcx,		rdi		; Total char count in rcx
+		mov		rdx,	QWORD	[OUT_LEN]	; Buffered char count in rdx
+		lea		rax,		[rdx + rcx]
+		cmp		rax,		OUT_BUF_SIZE
+		jbe		.append
+		push		rcx				; Kept from syscall
+		call		print_flush
+		pop		rcx
+		xor		rdx,		rdx
+
+.append:	lea		rdi,		[OUT_BUF + rdx]	; Buffer end in rdi
+		mov		rsi,		rbp
+		sub		rsi,		rcx		; Converted chars in rsi
+		add		rdx,		rcx
+		mov	QWORD	[OUT_LEN],	rdx
+		rep movsb
+
+		add		rsp,		32
+		pop		rbp
+
+		cmp	BYTE	[OUT_UNBUFFERED], 0
+		jne		print_flush
+.end:		ret
+
+; Write buffered output to stdout. Called by compiler before program exit.
+print_flush:	mov		rsi,		OUT_BUF		; buf addr in rsi
+		mov		rdx,	QWORD	[OUT_LEN]	; buf size in rdx
+
+.write:		test		rdx,		rdx
+		jle		.done
+		mov		rdi,		1		; rdi = 1 (stdout)
+		mov		rax,		1		; rax = 1 (write)
+		syscall
+
+		test		rax,		rax		; Drop output on error
+		jle		.done
+		add		rsi,		rax
+		sub		rdx,		rax
+		jmp		.write
+
+.done:		mov	QWORD	[OUT_LEN],	0
+		ret
+
+digit_pairs:	db		"00010203040506070809"
+		db		"10111213141516171819"
+		db		"20212223242526272829"
+		db		"30313233343536373839"
+		db		"40414243444546474849"
+		db		"50515253545556575859"
+		db		"60616263646566676869"
+		db		"70717273747576777879"
+		db		"80818283848586878889"
+		db		"90919293949596979899"
+
+read_num:	push		rbp
+		mov		rbp,		rsp
+
+		mov		rsi,	QWORD	[IN_POS]	; Next input char in rsi
+		mov		r8,	QWORD	[IN_END]	; End of buffered input in r8
+		xor		r9,		r9		; |x| * 1000 in r9
+		mov		r10,		1		; sign in r10
+
+.skip_space:	call		read_peek
+		cmp		rdx,		0x20		; ' ' and control chars
+		ja		.sign
+		inc		rsi
+		jmp		.skip_space
+
+.sign:		cmp		rdx,		0x2D		; '-'
+		jne		.int_part
+		neg		r10
+		inc		rsi
+
+.int_part:	call		read_peek
+		sub		rdx,		0x30		; '0'
+		cmp		rdx,		9
+		ja		.point
+		imul		r9,		r9,		10
+		add		r9,		rdx
+		inc		rsi
+		jmp		.int_part
+
+.point:		cmp		rdx,		-2		; '.' - '0'
+		jne		.convert_num
+		inc		rsi
+		mov		r15,		3		; Fraction digits left in r15
+
+.frac_part:	call		read_peek
+		sub		rdx,		0x30		; '0'
+		cmp		rdx,		9
+		ja		.pad_frac
+		inc		rsi
+		test		r15,		r15		; Extra digits are dropped
+		jz		.frac_part
+		imul		r9,		r9,		10
+		add		r9,		rdx
+		dec		r15
+		jmp		.frac_part
+
+.pad_frac:	test		r15,		r15
+		jz		.convert_num
+		imul		r9,		r9,		10
+		dec		r15
+		jmp		.pad_frac
+
+.convert_num:	mov	QWORD	[IN_POS],	rsi
+		mov	QWORD	[IN_END],	r8
+		mov		rax,		r9		; result in rax
+		mov		rdi,		r10		; sign in rdi
+
+		imul		rax,		rdi
+
+		cvtsi2sd	xmm0,		rax
+		mov		eax,		1000
+		cvtsi2sd	xmm1,		rax
+		divsd		xmm0,		xmm1
+		movq		rax,		xmm0
+
+		pop		rbp
+		ret
+
+; Next input char in rdx without consuming it, or -1 at end of input.
+; Input buffer is refilled from stdin when all of it is consumed.
+read_peek:	cmp		rsi,		r8
+		jb		.ready
+
+		xor		rdi,		rdi		; rdi = 0 (stdin)
+		mov		rsi,		IN_BUF		; rsi = buf addr
+		mov		rdx,		IN_BUF_SIZE	; rdx = buf size
+		xor		rax,		rax		; read
+		syscall
+
+		mov		rsi,		IN_BUF
+		test		rax,		rax		; Error is end of input
+		jg		.filled
+		xor		rax,		rax
+.filled:	lea		r8,		[rsi + rax]
+		mov		rdx,		-1
+		test		rax,		rax
+		jz		.done
+
+.ready:		movzx		edx,	BYTE	[rsi]
+.done:		ret
+
+sqrt:		push		rbp
+		mov		rbp,		rsp
+
+		sqrtsd		xmm0,	QWORD	[rbp + 16]
+		movq		rax,		xmm0
+
+		pop		rbp
+		ret
+
+stdlib_end:
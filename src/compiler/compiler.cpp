@@ -2,9 +2,11 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <stdint.h>
 
 #include "util/logger/logger.h"
 
@@ -14,9 +16,91 @@
 #include "data_structures/intermediate_repr/ir_dsl.h"
 
 #include "ir_bin_cvt.h"
+#include "ir_peephole.h"
+#include "reg_alloc.h"
+#include "stdlib_image.h"
 #include "compiler.h"
 
 inline long max_long(long a, long b) { return a > b ? a : b; }
+inline size_t min_size(size_t a, size_t b) { return a < b ? a : b; }
+
+/**
+ * @brief Standard library routines in order of their placement in binary
+ */
+enum stdlib_routine
+{
+    STDLIB_PRINT,
+    STDLIB_READ,
+    STDLIB_SQRT,
+
+    STDLIB_ROUTINE_COUNT
+};
+
+static const char* const stdlib_names[STDLIB_ROUTINE_COUNT] = {
+    "print", "read", "sqrt"
+};
+
+static const size_t stdlib_arg_cnts[STDLIB_ROUTINE_COUNT] = { 1, 0, 1 };
+
+/*
+    Labels of routines in standard library binary. Routines are linked only
+    if program calls them, so they must not reference each other. Each one
+    spans until the next routine or `STDLIB_END_LABEL`, and references to
+    number of fractional bits in it are marked with `STDLIB_SHIFT_REF_SUFFIX`
+    label placed right after their displacement.
+*/
+static const char* const stdlib_labels[STDLIB_ROUTINE_COUNT] = {
+    "print_num", "read_num", "sqrt"
+};
+
+static const char STDLIB_END_LABEL[]        = "stdlib_end";
+static const char STDLIB_FLUSH_LABEL[]      = "print_flush";
+static const char STDLIB_SHIFT_REF_SUFFIX[] = ".shift_ref";
+
+/*
+    Standard library keeps input and output buffers and their state in a
+    fixed area right below global variables, which is a part of the same
+    writable segment. Addresses must match ones in stdlib sources.
+*/
+static const size_t CODE_ADDR               = 0x400000;
+static const size_t CODE_FILE_OFFSET        = 0x1000;
+static const size_t RUNTIME_DATA_ADDR       = 0x5DF000;
+static const size_t RUNTIME_UNBUFFERED_ADDR = 0x5DF008;
+static const size_t GLOBAL_VARS_ADDR        = 0x600000;
+
+/*
+    Functions defined in program receive first arguments in `call_arg_regs`
+    and the rest on stack, pushed left to right. Stack arguments are removed
+    by callee. Standard library functions receive all arguments on stack and
+    leave them for caller to remove.
+
+    Registers from `var_saved_regs` hold variables and are preserved by
+    every function. They are pushed before RBP, so stack arguments are
+    placed above them.
+*/
+static const ir_reg call_arg_regs[] = {
+    IR_REG_RDI, IR_REG_RSI, IR_REG_R14, IR_REG_R15
+};
+
+static const size_t call_arg_reg_cnt =
+                            sizeof(call_arg_regs) / sizeof(*call_arg_regs);
+
+static const ir_reg var_saved_regs[] = {
+    IR_REG_RBX, IR_REG_R12, IR_REG_R13
+};
+
+static const size_t var_saved_reg_cnt =
+                            sizeof(var_saved_regs) / sizeof(*var_saved_regs);
+
+/**
+ * @brief Location of local variable or argument, which occupies frame slot
+ * in name scope. Only variables without register take space in stack frame.
+ */
+struct var_slot
+{
+    ir_reg  reg;        // Register holding variable or `IR_REG_NONE`
+    long    offset;     // Offset below RBP for variable in memory
+};
 
 struct compilation_state
 {
@@ -30,14 +114,35 @@ struct compilation_state
     size_t global_var_cnt;
     size_t stack_frame_size;
 
+    long     fixed_scale;   // Fixed-point number denominator
+    unsigned fixed_shift;   // log2(fixed_scale) for binary scale, else 0
+    bool     use_double;    // Numbers are doubles, fixed_scale is unused
+
+    size_t arg_reg_cnt;     // Arguments of current function passed in registers
+    size_t stack_arg_cnt;   // Arguments of current function passed on stack
+    size_t arg_idx;         // Index of next declared argument
+    bool   frameless;       // Current function does not create stack frame
+
+    reg_allocation var_regs;    // Registers of current function variables
+    var_slot* slots;            // Locations of visible local variables
+    const ast_node* cached_loop;    // Loop, whose globals are in registers
+    const stdlib_image* stdlib_variant;
+    bool unbuffered_output; // Output is written by every 'print' call
+
     ir_node_stack   ir_stack;
+    ir_arena        ir_nodes;   // Storage of all IR nodes
 
     ir_node_ptr stdlib;
+    ir_node_ptr stdlib_flush;   // Entry of buffered output flush
+    size_t      stdlib_size;    // Size of linked standard library routines
     ir_node_ptr ir_head;
     ir_node_ptr ir_tail;
     ir_node_ptr func_return;
+    ir_node_ptr func_body;      // Target of self tail calls
 };
 
+static const unsigned ELF_SECTION_COUNT = 4;
+
 static const char sect_name_table[] = {
     '\0',
     '.', 't', 'e', 'x', 't', '\0',
@@ -45,15 +150,31 @@ static const char sect_name_table[] = {
     '.', 's', 't', 'r', 't', 'a', 'b', '\0'
 };
 
-static void state_ctor(compilation_state* state, bool use_stdlib);
+static void state_ctor(compilation_state* state,
+                       const compiler_options* options);
 static void state_dtor(compilation_state* state);
 static void state_add_ir_node(compilation_state* state, ir_node* node);
 
-static void add_elf_headers(FILE* output, compilation_state* state);
-static void add_elf_sections(FILE* output, compilation_state* state);
-static size_t link_stdlib(FILE* output);
+static bool write_executable(FILE* output, const compilation_state* state);
+static void add_elf_headers(unsigned char* image,
+                            const compilation_state* state);
+static void add_elf_sections(unsigned char* image,
+                             const compilation_state* state);
+static void mark_used_functions(const ast_node* node,
+                                compilation_state* state);
+static bool is_routine_used(const compilation_state* state, size_t routine);
+static void layout_stdlib(compilation_state* state);
+static void link_stdlib(unsigned char* image, const compilation_state* state);
 static bool extract_declarations(const ast_node* node, compilation_state* state);
 static bool compile_node        (const ast_node* node, compilation_state* state);
+static bool compile_expression  (const ast_node* node, compilation_state* state);
+static bool compile_condition   (const ast_node* node, compilation_state* state);
+static bool compile_cond_flags  (const ast_node* node, compilation_state* state,
+                                 ir_cond_flags* cond);
+static bool is_tail_call        (const ast_node* node, compilation_state* state);
+static bool compile_tail_call   (const ast_node* node, compilation_state* state);
+static bool get_var_operand(const char* name, compilation_state* state,
+                            ir_operand* operand);
 
 #define STEP_WITH_CLEANUP(action, cleanup)\
     LOG_ASSERT(action, { cleanup; return false; })
@@ -70,10 +191,10 @@ static bool compile_node        (const ast_node* node, compilation_state* state)
 
 
 bool compiler_tree_to_asm(const abstract_syntax_tree *tree, FILE *output,
-                          bool use_stdlib)
+                          const compiler_options* options)
 {
     compilation_state state = {};
-    state_ctor(&state, use_stdlib);
+    state_ctor(&state, options);
 
     STEP_WITH_CLEANUP(extract_declarations(tree->root, &state),
                         state_dtor(&state));
@@ -87,10 +208,44 @@ bool compiler_tree_to_asm(const abstract_syntax_tree *tree, FILE *output,
         NULL
     );
 
+    // Only functions called from global initializers or reachable from
+    // 'main' are compiled and linked
+    state.functions.data[main - state.functions.data].is_used = true;
+    mark_used_functions(main->node, &state);
+    for (const ast_node* defs = tree->root; defs; defs = defs->right)
+        if (defs->left->type == NODE_NVAR)
+            mark_used_functions(defs->left, &state);
+    layout_stdlib(&state);
+
+    const bool has_output = is_routine_used(&state, STDLIB_PRINT);
+    if (has_output && state.unbuffered_output)
+    {
+        const ir_operand flag = { .flags = IR_OPERAND_MEM | IR_OPERAND_IMM,
+                                  .reg = IR_REG_NONE,
+                                  .immediate = RUNTIME_UNBUFFERED_ADDR };
+        state_add_ir_node(&state, ir_node_new_binary(IR_MOV, flag,
+                                                     ir_operand_imm(1)));
+    }
     state_add_ir_node(&state, ir_node_new_call(main->ir_list_head));
-    state_add_ir_node(&state, ir_node_new_binary(IR_MOV,
-                                        ir_operand_reg(IR_REG_RDI),
-                                        ir_operand_reg(IR_REG_RAX)));
+    if (has_output)     // Return value is kept while buffer is written
+    {
+        state_add_ir_node(&state, ir_node_new_push_reg(IR_REG_RAX));
+        state_add_ir_node(&state, ir_node_new_call(state.stdlib_flush));
+        state_add_ir_node(&state, ir_node_new_pop_reg(IR_REG_RAX));
+    }
+    if (state.use_double)   // Exit code is truncated return value
+    {
+        state_add_ir_node(&state, ir_node_new_binary(IR_MOVQ,
+                                            ir_operand_reg(IR_REG_XMM0),
+                                            ir_operand_reg(IR_REG_RAX)));
+        state_add_ir_node(&state, ir_node_new_binary(IR_CVTTSD2SI,
+                                            ir_operand_reg(IR_REG_RDI),
+                                            ir_operand_reg(IR_REG_XMM0)));
+    }
+    else
+        state_add_ir_node(&state, ir_node_new_binary(IR_MOV,
+                                            ir_operand_reg(IR_REG_RDI),
+                                            ir_operand_reg(IR_REG_RAX)));
     state_add_ir_node(&state, ir_node_new_binary(IR_MOV,
                                         ir_operand_reg(IR_REG_RAX),
                                         ir_operand_imm(0x3C)));  // call exit
@@ -99,55 +254,82 @@ bool compiler_tree_to_asm(const abstract_syntax_tree *tree, FILE *output,
     
     for (size_t i = 0; i < state.functions.size; i++)
     {
-        if (state.functions.data[i].node == NULL)   // stdlib function
+        if (state.functions.data[i].node == NULL    // stdlib function
+                || !state.functions.data[i].is_used)
             continue;
         STEP_WITH_CLEANUP(
             compile_node(state.functions.data[i].node, &state),
             state_dtor(&state)
         );
     }
-    size_t base_offset = 0x400103;  // Default for 64-bit + stdlib size
+    peephole_stats stats = {};
+    ir_peephole_optimize(state.ir_head, &stats);
+    if (options->show_peephole_stats)
+        peephole_stats_print(&stats, stdout);
+
+    ir_align_blocks(state.ir_head, options->func_align, options->loop_align);
+
+    state.ir_tail = state.ir_head;  // Tail could have been removed
+    while (state.ir_tail->next)
+        state.ir_tail = state.ir_tail->next;
+
+    size_t base_offset = CODE_ADDR + state.stdlib_size;
 
     // TODO: EXTRAAAAAAAAAAAAAAAAAAAAAAAAAAAAACT
-    ir_to_binary(state.ir_head, base_offset);
-    add_elf_headers(output, &state);
-    fseek(output, 0x1000, SEEK_SET);
-    link_stdlib(output);    // TODO: make optional
-    ir_list_write(state.ir_head, output);
-    fseek(output, 0x2000, SEEK_SET);
-    fwrite(sect_name_table, sizeof(sect_name_table), 1, output);
-    add_elf_sections(output, &state);
+    ir_to_binary(state.ir_head, base_offset,
+                 options->target != TARGET_SSE2);
+    STEP_WITH_CLEANUP(write_executable(output, &state), state_dtor(&state));
 
     // ir_list_dump(state.ir_head, stdout);
     state_dtor(&state);
     return true;
 }
 
-static void state_ctor(compilation_state* state, bool use_stdlib)
+static void state_ctor(compilation_state* state,
+                       const compiler_options* options)
 {
     func_array_ctor(&state->functions);
     table_stack_ctor(&state->name_scope);
     ir_stack_ctor(&state->ir_stack);
+    ir_arena_ctor(&state->ir_nodes);
+    ir_arena_select(&state->ir_nodes);
 
+    state->use_double = options->use_double;
+    state->unbuffered_output = options->unbuffered_output;
+    if (options->use_double)
+    {
+        state->fixed_scale    = 1;
+        state->fixed_shift    = 0;
+        state->stdlib_variant = &stdlib_double;
+    }
+    else if (options->fixed_pow2)
+    {
+        state->fixed_scale    = 1l << options->fixed_shift;
+        state->fixed_shift    = options->fixed_shift;
+        state->stdlib_variant = &stdlib_pow2;
+    }
+    else
+    {
+        state->fixed_scale    = 1000;
+        state->fixed_shift    = 0;
+        state->stdlib_variant = &stdlib_dec;
+    }
+
+    // Addresses of routines are known once used ones are found
     state->stdlib = ir_node_new_empty();
     ir_node* stdlib_tail = state->stdlib;
-    if (use_stdlib)
-    {
-        ir_node* print = ir_node_new_empty();
-        print->addr    = 0x400000;
-        array_push(&state->functions, { NULL, print, "print", 1 });
-        stdlib_tail = ir_list_insert_after(stdlib_tail, print);
-
-        ir_node* read  = ir_node_new_empty();
-        read->addr     = 0x40006c;
-        array_push(&state->functions, { NULL, read, "read", 0 });
-        stdlib_tail = ir_list_insert_after(stdlib_tail, read);
-
-        ir_node* sqrt  = ir_node_new_empty();
-        sqrt->addr     = 0x4000CA;
-        array_push(&state->functions, { NULL, sqrt, "sqrt", 1 });
-        stdlib_tail = ir_list_insert_after(stdlib_tail, sqrt);
-        
+    if (options->use_stdlib)
+    {
+        for (size_t i = 0; i < STDLIB_ROUTINE_COUNT; ++i)
+        {
+            ir_node* routine = ir_node_new_empty();
+            array_push(&state->functions, { NULL, routine, stdlib_names[i],
+                                            stdlib_arg_cnts[i] });
+            stdlib_tail = ir_list_insert_after(stdlib_tail, routine);
+        }
+        state->stdlib_flush = ir_node_new_empty();
+        stdlib_tail = ir_list_insert_after(stdlib_tail, state->stdlib_flush);
+
         stdlib_tail = ir_list_insert_after(stdlib_tail, ir_node_new_empty());
     }
 
@@ -160,9 +342,9 @@ static void state_dtor(compilation_state* state)
     func_array_dtor(&state->functions);
     table_stack_dtor(&state->name_scope);
     ir_stack_dtor(&state->ir_stack);
-    ir_list_clear(state->stdlib);
-
-    if (state->func_return) free(state->func_return);
+    ir_arena_dtor(&state->ir_nodes);   // Releases all IR nodes
+    reg_allocation_dtor(&state->var_regs);
+    free(state->slots);
     state = {};
 }
 
@@ -171,11 +353,80 @@ static void state_add_ir_node(compilation_state* state, ir_node* node)
     state->ir_tail = ir_list_insert_after(state->ir_tail, node);
 }
 
-static void add_elf_headers(FILE* output, compilation_state* state)
+/* Size of standard library and compiled program */
+static inline size_t get_code_size(const compilation_state* state)
+{
+    return state->ir_tail->addr + state->ir_tail->encoded_length - CODE_ADDR;
+}
+
+/* Size of runtime data and global variables */
+static inline size_t get_data_size(const compilation_state* state)
+{
+    return GLOBAL_VARS_ADDR - RUNTIME_DATA_ADDR + state->global_var_cnt * 8;
+}
+
+/* Section name table is placed after code and followed by section headers */
+static inline size_t get_section_headers_offset(const compilation_state* state)
+{
+    return CODE_FILE_OFFSET + get_code_size(state) + sizeof(sect_name_table);
+}
+
+static bool write_executable(FILE* output, const compilation_state* state)
+{
+    const size_t image_size = get_section_headers_offset(state)
+                            + ELF_SECTION_COUNT * sizeof(Elf64_Shdr);
+    int fd = fileno(output);
+    struct stat output_stat = {};
+    LOG_ASSERT_ERROR(fstat(fd, &output_stat) == 0, return false,
+        "Failed to access output file: %s", strerror(errno));
+
+    // Pipes and terminals cannot be mapped, so image is built in memory
+    const bool is_mapped = S_ISREG(output_stat.st_mode);
+    unsigned char* image = NULL;
+    if (is_mapped)
+    {
+        LOG_ASSERT_ERROR(ftruncate(fd, (off_t) image_size) == 0, return false,
+            "Failed to resize output file: %s", strerror(errno));
+        void* mapped = mmap(NULL, image_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0);
+        LOG_ASSERT_ERROR(mapped != MAP_FAILED, return false,
+            "Failed to map output file: %s", strerror(errno));
+        image = (unsigned char*) mapped;
+    }
+    else
+        image = (unsigned char*) calloc(image_size, 1);
+
+    add_elf_headers(image, state);
+    link_stdlib(image + CODE_FILE_OFFSET, state);
+    unsigned char* code = image + CODE_FILE_OFFSET + state->stdlib_size;
+    code += ir_list_write(state->ir_head, code);
+    memcpy(code, sect_name_table, sizeof(sect_name_table));
+    add_elf_sections(image, state);
+
+    if (is_mapped)
+    {
+        munmap(image, image_size);
+        return true;
+    }
+
+    bool success = true;
+
+    for (size_t written = 0; success && written < image_size;)
+    {
+        ssize_t result = write(fd, image + written, image_size - written);
+        LOG_ASSERT_ERROR(result > 0 || errno == EINTR, success = false,
+            "Failed to write output: %s", strerror(errno));
+        if (result > 0) written += (size_t) result;
+    }
+    free(image);
+    return success;
+}
+
+static void add_elf_headers(unsigned char* image,
+                            const compilation_state* state)
 {
     size_t entry_addr = state->ir_head->addr;
-    size_t code_size = state->ir_tail->addr + state->ir_tail->encoded_length
-                        - 0x400000;
+    size_t code_size = get_code_size(state);
     Elf64_Ehdr elf_header = {
         .e_ident = {
             ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3,
@@ -190,13 +441,13 @@ static void add_elf_headers(FILE* output, compilation_state* state)
         .e_version = EV_CURRENT,
         .e_entry = entry_addr,
         .e_phoff = sizeof(Elf64_Ehdr),
-        .e_shoff = 0x2000 + sizeof(sect_name_table),
+        .e_shoff = get_section_headers_offset(state),
         .e_flags = 0,
         .e_ehsize = sizeof(Elf64_Ehdr),
         .e_phentsize = sizeof(Elf64_Phdr),
         .e_phnum = 2,
         .e_shentsize = sizeof(Elf64_Shdr),
-        .e_shnum = 4,
+        .e_shnum = ELF_SECTION_COUNT,
         .e_shstrndx = 3
     };
 
@@ -204,9 +455,9 @@ static void add_elf_headers(FILE* output, compilation_state* state)
     Elf64_Phdr load_exec = {
         .p_type = PT_LOAD,
         .p_flags = PF_R | PF_X,
-        .p_offset = 0x1000,
-        .p_vaddr = 0x400000,
-        .p_paddr = 0x400000,
+        .p_offset = CODE_FILE_OFFSET,
+        .p_vaddr = CODE_ADDR,
+        .p_paddr = CODE_ADDR,
         .p_filesz = code_size,
         .p_memsz = code_size,
         .p_align = 0x1000
@@ -214,30 +465,32 @@ static void add_elf_headers(FILE* output, compilation_state* state)
     Elf64_Phdr load_write = {
         .p_type = PT_LOAD,
         .p_flags = PF_R | PF_W,
-        .p_offset = 0x2000,
-        .p_vaddr = 0x401000,
-        .p_paddr = 0x401000,
-        .p_filesz = sizeof(sect_name_table),
-        .p_memsz = state->global_var_cnt * 8 + sizeof(sect_name_table),
+        .p_offset = 0,
+        .p_vaddr = RUNTIME_DATA_ADDR,
+        .p_paddr = RUNTIME_DATA_ADDR,
+        .p_filesz = 0,
+        .p_memsz = get_data_size(state),
         .p_align = 0x1000
     };
 
-    fwrite(&elf_header, sizeof(elf_header), 1, output);
-    fwrite(&load_exec,  sizeof(load_exec),  1, output);
-    fwrite(&load_write, sizeof(load_write), 1, output);
+    memcpy(image, &elf_header, sizeof(elf_header));
+    image += sizeof(elf_header);
+    memcpy(image, &load_exec,  sizeof(load_exec));
+    image += sizeof(load_exec);
+    memcpy(image, &load_write, sizeof(load_write));
 }
 
-static void add_elf_sections(FILE* output, compilation_state* state)
+static void add_elf_sections(unsigned char* image,
+                             const compilation_state* state)
 {
-    size_t code_size = state->ir_tail->addr + state->ir_tail->encoded_length
-                        - 0x400000;
+    size_t code_size = get_code_size(state);
     Elf64_Shdr rzvd = {};
     Elf64_Shdr text = {
         .sh_name = 1,
         .sh_type = SHT_PROGBITS,
         .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
-        .sh_addr = 0x400000,
-        .sh_offset = 0x1000,
+        .sh_addr = CODE_ADDR,
+        .sh_offset = CODE_FILE_OFFSET,
         .sh_size = code_size,
         .sh_link = 0,
         .sh_info = 0,
@@ -248,9 +501,9 @@ static void add_elf_sections(FILE* output, compilation_state* state)
         .sh_name = 7,
         .sh_type = SHT_NOBITS,
         .sh_flags = SHF_WRITE | SHF_ALLOC,
-        .sh_addr = 0x401000,
-        .sh_offset = 0x2000,
-        .sh_size = state->global_var_cnt * 8,
+        .sh_addr = RUNTIME_DATA_ADDR,
+        .sh_offset = CODE_FILE_OFFSET + code_size,
+        .sh_size = get_data_size(state),
         .sh_link = 0,
         .sh_info = 0,
         .sh_addralign = 0x8,
@@ -260,33 +513,170 @@ static void add_elf_sections(FILE* output, compilation_state* state)
         .sh_name = 12,
         .sh_type = SHT_STRTAB,
         .sh_flags = 0,
-        .sh_addr = 0x401000 + state->global_var_cnt * 8,
-        .sh_offset = 0x2000,
+        .sh_addr = 0,
+        .sh_offset = CODE_FILE_OFFSET + code_size,
         .sh_size = sizeof(sect_name_table),
         .sh_link = 0,
         .sh_info = 0,
-        .sh_addralign = 0x8,
+        .sh_addralign = 0x1,
         .sh_entsize = 0
     };
-    fwrite(&rzvd,   sizeof(Elf64_Shdr), 1, output);
-    fwrite(&text,   sizeof(Elf64_Shdr), 1, output);
-    fwrite(&bss,    sizeof(Elf64_Shdr), 1, output);
-    fwrite(&strtab, sizeof(Elf64_Shdr), 1, output);
+    const Elf64_Shdr headers[] = { rzvd, text, bss, strtab };
+    memcpy(image + get_section_headers_offset(state), headers,
+           sizeof(headers));
+}
+
+static bool is_routine_used(const compilation_state* state, size_t routine)
+{
+    const function* func = func_array_find_func(&state->functions,
+                                                stdlib_names[routine]);
+    return func && func->is_used;
+}
+
+static size_t get_stdlib_symbol(const stdlib_image* lib, const char* name)
+{
+    for (size_t i = 0; i < lib->symbol_cnt; ++i)
+        if (strcmp(lib->symbols[i].name, name) == 0)
+            return lib->symbols[i].offset;
+
+    LOG_ASSERT(0 && "Label is missing from standard library", return 0);
+}
+
+/* Find [start; end) range of standard library routine */
+static void get_routine_range(const stdlib_image* lib, size_t routine,
+                              size_t* start, size_t* end)
+{
+    *start = get_stdlib_symbol(lib, stdlib_labels[routine]);
+    *end   = get_stdlib_symbol(lib, STDLIB_END_LABEL);
+    for (size_t i = 0; i < STDLIB_ROUTINE_COUNT; ++i)
+    {
+        const size_t next = get_stdlib_symbol(lib, stdlib_labels[i]);
+        if (*start < next && next < *end)
+            *end = next;
+    }
+}
+
+static bool is_shift_ref(const stdlib_symbol* symbol)
+{
+    const size_t len        = strlen(symbol->name);
+    const size_t suffix_len = sizeof(STDLIB_SHIFT_REF_SUFFIX) - 1;
+    return len > suffix_len && strcmp(symbol->name + len - suffix_len,
+                                      STDLIB_SHIFT_REF_SUFFIX) == 0;
+}
+
+/* Place used routines one after another, followed by number of fractional
+ * bits, if any of them needs it */
+static void layout_stdlib(compilation_state* state)
+{
+    const stdlib_image* lib = state->stdlib_variant;
+    const size_t flush = get_stdlib_symbol(lib, STDLIB_FLUSH_LABEL);
+    size_t offset = 0;
+    bool needs_shift = false;
+    for (size_t i = 0; i < STDLIB_ROUTINE_COUNT; ++i)
+    {
+        if (!is_routine_used(state, i))
+            continue;
+
+        size_t start = 0, end = 0;
+        get_routine_range(lib, i, &start, &end);
+        func_array_find_func(&state->functions, stdlib_names[i])
+                                    ->ir_list_head->addr = CODE_ADDR + offset;
+        if (start <= flush && flush < end)
+            state->stdlib_flush->addr = CODE_ADDR + offset + flush - start;
+
+        for (size_t j = 0; j < lib->symbol_cnt; ++j)
+            needs_shift |= is_shift_ref(&lib->symbols[j])
+                        && start < lib->symbols[j].offset
+                        && lib->symbols[j].offset <= end;
+        offset += end - start;
+    }
+    state->stdlib_size = offset + (needs_shift ? 1 : 0);
 }
 
-static size_t link_stdlib(FILE* output)
+static void link_stdlib(unsigned char* image, const compilation_state* state)
 {
-    int fd = open("assets/stdlib.bin", O_RDONLY);
-    struct stat file_stat = {};
-    fstat(fd, &file_stat);
-    size_t file_size = file_stat.st_size;
+    if (state->stdlib_size == 0)
+        return;
 
-    void* mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
+    const stdlib_image* lib = state->stdlib_variant;
+    const size_t shift_offset = state->stdlib_size - 1;
+    size_t offset = 0;
+    for (size_t i = 0; i < STDLIB_ROUTINE_COUNT; ++i)
+    {
+        if (!is_routine_used(state, i))
+            continue;
+
+        size_t start = 0, end = 0;
+        get_routine_range(lib, i, &start, &end);
+        memcpy(image + offset, lib->code + start, end - start);
+        for (size_t j = 0; j < lib->symbol_cnt; ++j)
+        {
+            const stdlib_symbol* ref = &lib->symbols[j];
+            if (!is_shift_ref(ref) || ref->offset <= start || end < ref->offset)
+                continue;
+
+            // Point reference to moved byte and patch number of fractional bits
+            const size_t ref_end = offset + ref->offset - start;
+            const int32_t disp = (int32_t) (shift_offset - ref_end);
+            memcpy(image + ref_end - sizeof(disp), &disp, sizeof(disp));
+            image[shift_offset] = (unsigned char) state->fixed_shift;
+        }
+        offset += end - start;
+    }
+}
+
+/**
+ * @brief Check whether `node` is a call to standard library function,
+ * which is expanded in place instead of being called
+ */
+static bool is_intrinsic_call(const ast_node* node,
+                              const compilation_state* state)
+{
+    if (node->type != NODE_CALL || strcmp(node->value.name, "sqrt") != 0)
+        return false;
+
+    const function* func = func_array_find_func(&state->functions,
+                                                node->value.name);
+    return func && func->node == NULL;
+}
+
+/**
+ * @brief Check whether expression or statement makes any calls, which are
+ * not expanded in place
+ */
+static bool contains_call(const ast_node* node,
+                          const compilation_state* state)
+{
+    if (node == NULL)
+        return false;
+    if (node->type == NODE_CALL && !is_intrinsic_call(node, state))
+        return true;
+    return contains_call(node->left, state) || contains_call(node->right, state);
+}
+
+/**
+ * @brief Mark functions called from `node` as used, along with functions
+ * called from their bodies
+ */
+static void mark_used_functions(const ast_node* node,
+                                compilation_state* state)
+{
+    if (node == NULL)
+        return;
+
+    if (node->type == NODE_CALL && !is_intrinsic_call(node, state))
+    {
+        const function* func = func_array_find_func(&state->functions,
+                                                    node->value.name);
+        if (func && !func->is_used)
+        {
+            state->functions.data[func - state->functions.data].is_used = true;
+            mark_used_functions(func->node, state);
+        }
+    }
 
-    fwrite(mapped, 1, file_size, output);
-    munmap(mapped, file_size);
-    return file_size;
+    mark_used_functions(node->left,  state);
+    mark_used_functions(node->right, state);
 }
 
 bool extract_declarations(const ast_node *node, compilation_state *state)
@@ -334,8 +724,18 @@ bool compile_node(const ast_node *node, compilation_state *state)
 {
     if (node == NULL) return true;
 
+    if (node->type == NODE_OP    || node->type == NODE_CALL ||
+        node->type == NODE_CONST || node->type == NODE_VAR)
+        return compile_expression(node, state);
+
+    if (node->type == NODE_RET && is_tail_call(node, state))
+        return compile_tail_call(node, state);
+
     STEP(on_compiling_left(node, state));
-    STEP(compile_node(node->left, state));
+    if (node->type == NODE_IF || node->type == NODE_WHILE)
+        STEP(compile_condition(node->left, state));
+    else
+        STEP(compile_node(node->left, state));
     STEP(on_compiled_left(node, state));
 
     STEP(on_compiling_right(node, state));
@@ -414,6 +814,29 @@ define_compile(DEFS)
     return false; /* this function should not be called */
 }
 
+/* Bind frame slot of declared variable to its register */
+static void bind_var_reg(const ast_node* node, compilation_state* state)
+{
+    long addr = 0;
+    bool is_global = false;
+    if (!table_stack_find_var(&state->name_scope, node->value.name,
+                              &is_global, &addr) || is_global || addr <= 0)
+        return;
+
+    // Slots below this one belong to visible variables
+    const size_t idx = (size_t) addr / 8 - 1;
+    var_slot* slot = &state->slots[idx];
+    slot->reg    = reg_allocation_find(&state->var_regs, node);
+    slot->offset = 8;
+    if (idx > 0)
+        slot->offset = state->slots[idx - 1].offset
+                     + (state->slots[idx - 1].reg == IR_REG_NONE ? 8 : 0);
+
+    if (slot->reg == IR_REG_NONE)
+        state->stack_frame_size = max_long((long) state->stack_frame_size,
+                                           slot->offset + 8);
+}
+
 define_compile(NVAR)
 {
     if (stage != STAGE_COMPILED_RIGHT)
@@ -421,56 +844,156 @@ define_compile(NVAR)
     table_stack_add_var(&state->name_scope, node->value.name);
     if (table_stack_is_at_global_scope(&state->name_scope))
         ++ state->global_var_cnt;
+    else
+        bind_var_reg(node, state);
 
     return compile(ASS, COMPILED_RIGHT); // Initialization is compiled the
                                             // same way as assignment
 }
 
+static bool ast_contains(const ast_node* node, node_type type)
+{
+    if (node == NULL)
+        return false;
+    if (node->type == type)
+        return true;
+    return ast_contains(node->left, type) || ast_contains(node->right, type);
+}
+
+/**
+ * @brief Assign registers to variables of function. Leaf functions keep
+ * arguments in place and can also use free argument registers, while
+ * other functions only get registers preserved across calls. In double
+ * mode every variable stays in memory, as SSE instructions cannot use
+ * general-purpose registers.
+ */
+static void allocate_var_regs(const ast_node* node, compilation_state* state)
+{
+    const bool is_leaf  = !contains_call(node, state);
+    const bool use_regs = !state->use_double;
+    const reg_alloc_params params = {
+        .arg_regs      = call_arg_regs,
+        .arg_reg_cnt   = state->arg_reg_cnt,
+        .free_regs     = call_arg_regs,
+        .free_reg_cnt  = use_regs && is_leaf ? call_arg_reg_cnt : 0,
+        .saved_regs    = var_saved_regs,
+        .saved_reg_cnt = use_regs ? var_saved_reg_cnt : 0,
+        .is_leaf       = use_regs && is_leaf
+    };
+    reg_allocation_ctor(&state->var_regs, node, &params);
+
+    state->slots = (var_slot*) calloc(state->var_regs.decl_cnt + 1,
+                                      sizeof(*state->slots));
+}
+
+/**
+ * @brief Check whether function can skip stack frame creation. This is
+ * true for leaf functions, whose variables all fit into registers.
+ */
+static bool is_frameless_function(const ast_node* node,
+                                  const compilation_state* state)
+{
+    if (state->use_double || state->stack_arg_cnt > 0)
+        return false;
+
+    return !contains_call(node, state) && state->var_regs.all_in_regs;
+}
+
+/* Restore preserved registers, which were pushed in function prologue */
+static void compile_restore_regs(compilation_state* state)
+{
+    for (size_t i = state->var_regs.saved_cnt; i > 0; --i)
+        state_add_ir_node(state,
+                    ir_node_new_pop_reg(state->var_regs.saved_regs[i - 1]));
+}
+
 define_compile(NFUN)
 {
     const function* self = NULL;
+    ir_node* ret_node = NULL;
+    const ast_node* arg = NULL;
+    long arg_offset = 8;
     switch (stage)
     {
         case STAGE_COMPILING_LEFT:
             state->func_name = node->value.name;
             state->has_return = false;
-            state->stack_frame_size = 0;
             self = func_array_find_func(&state->functions, state->func_name);
 
-            // Function arguments in separate scope, starting at
-            // [rbp+8+8*argcnt]
-            table_stack_add_table(&state->name_scope,
-                                    -8 - 8 * self->arg_cnt);
+            state->arg_reg_cnt   = min_size(self->arg_cnt, call_arg_reg_cnt);
+            state->stack_arg_cnt = self->arg_cnt - state->arg_reg_cnt;
+            state->arg_idx       = 0;
+            allocate_var_regs(node, state);
+            state->frameless     = is_frameless_function(node, state);
+            state->stack_frame_size = 8;
+
+            // Register arguments without allocated registers are saved to
+            // stack frame, starting at [rbp-8]
+            table_stack_add_table(&state->name_scope, 8);
 
-            
             // Add root node for others to reference
             state_add_ir_node(state, self->ir_list_head);
-            // push rbp
-            state_add_ir_node(state, ir_node_new_push_reg(IR_REG_RBP));
-            // mov rbp, rsp
-            state_add_ir_node(state, ir_node_new_binary(IR_MOV,
-                                             ir_operand_reg(IR_REG_RBP),
-                                             ir_operand_reg(IR_REG_RSP)));
+            for (size_t i = 0; i < state->var_regs.saved_cnt; ++i)
+                state_add_ir_node(state,
+                        ir_node_new_push_reg(state->var_regs.saved_regs[i]));
+            if (!state->frameless)
+            {
+                // push rbp
+                state_add_ir_node(state, ir_node_new_push_reg(IR_REG_RBP));
+                // mov rbp, rsp
+                state_add_ir_node(state, ir_node_new_binary(IR_MOV,
+                                                ir_operand_reg(IR_REG_RBP),
+                                                ir_operand_reg(IR_REG_RSP)));
+            }
             // Save function start to fill stack frame info
             ir_stack_push(&state->ir_stack, state->ir_tail);
 
+            // Self tail calls put new arguments in place and jump here
+            state->func_body = ir_node_new_empty();
+            state_add_ir_node(state, state->func_body);
+
+            arg = node->left;
+            for (size_t i = 0; i < state->arg_reg_cnt; ++i, arg = arg->right)
+            {
+                const ir_reg reg = reg_allocation_find(&state->var_regs, arg);
+                if (reg == call_arg_regs[i])
+                    continue;
+
+                // mov [rbp-OFFSET], reg
+                ir_operand slot = {
+                    .flags = IR_OPERAND_MEM | IR_OPERAND_REG | IR_OPERAND_IMM,
+                    .reg = IR_REG_RBP,
+                    .immediate = -arg_offset
+                };
+                if (reg != IR_REG_NONE)
+                    slot = ir_operand_reg(reg);
+                else
+                    arg_offset += 8;
+                state_add_ir_node(state, ir_node_new_binary(IR_MOV, slot,
+                                            ir_operand_reg(call_arg_regs[i])));
+            }
+
             state->func_return = ir_node_new_empty();                                  
             return true;
         case STAGE_COMPILED_LEFT:
-            table_stack_add_table(&state->name_scope, 8);
+            table_stack_add_table(&state->name_scope,
+                                  8 + 8 * (long) state->arg_reg_cnt);
             return true;
         case STAGE_COMPILED_RIGHT:
             table_stack_pop_table(&state->name_scope);
             AST_ASSERT(state->has_return, "Control reaches end of function '%s'", node->value.name);
             state->func_name = NULL;
             state->has_return = false;
+            if (state->stack_arg_cnt > 0)
+                table_stack_pop_table(&state->name_scope);
             table_stack_pop_table(&state->name_scope);
             state_add_ir_node(state, state->func_return);
             state->func_return = NULL;
+            state->func_body = NULL;
             state->stack_frame_size -= 8;       // Discard initial offset
 
-            if (state->stack_frame_size > 0)   // Create stack frame
-            {
+            if (!state->frameless && state->stack_frame_size > 0)
+            {                                   // Create stack frame
                 ir_node* func_start = ir_stack_top(&state->ir_stack);
                 const size_t frame_size = state->stack_frame_size;
 
@@ -488,8 +1011,19 @@ define_compile(NFUN)
             }
 
             ir_stack_pop(&state->ir_stack);
-            state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RBP));
-            state_add_ir_node(state, ir_node_new_ret());
+            if (!state->frameless)
+                state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RBP));
+            compile_restore_regs(state);
+
+            ret_node = ir_node_new_ret();
+            if (state->stack_arg_cnt > 0)       // Remove stack arguments
+                ret_node->operand1 = ir_operand_imm(
+                                        8 * (long) state->stack_arg_cnt);
+            state_add_ir_node(state, ret_node);
+            state->frameless = false;
+            reg_allocation_dtor(&state->var_regs);
+            free(state->slots);
+            state->slots = NULL;
             return true;
 
         case STAGE_COMPILING_RIGHT:
@@ -514,11 +1048,6 @@ define_compile(BLOCK)
             return true;
         case STAGE_COMPILED_RIGHT:
             state->block_depth--;
-            // Update frame size
-            state->stack_frame_size = max_long(state->stack_frame_size,
-                                               table_stack_get_next_offset(
-                                                        &state->name_scope));       
-
             table_stack_pop_table(&state->name_scope);
             return true;
         case STAGE_COMPILING_LEFT:
@@ -536,10 +1065,21 @@ define_compile(ARG)
 {
     switch (stage)
     {
-        case STAGE_COMPILING_RIGHT:
-            return compile(NVAR, COMPILING_RIGHT);  // Argument creation is simply variable definition
-        case STAGE_COMPILED_RIGHT:
         case STAGE_COMPILING_LEFT:
+            // Stack arguments in separate scope, starting at
+            // [rbp+8+8*stack_arg_cnt] above preserved registers
+            if (state->arg_idx == state->arg_reg_cnt)
+                table_stack_add_table(&state->name_scope,
+                                      -8 - 8 * (long) (state->stack_arg_cnt
+                                                + state->var_regs.saved_cnt));
+            ++ state->arg_idx;
+
+            // Arguments are already in place, so only their names are added
+            table_stack_add_var(&state->name_scope, node->value.name);
+            bind_var_reg(node, state);
+            return true;
+        case STAGE_COMPILED_RIGHT:
+        case STAGE_COMPILING_RIGHT:
         case STAGE_COMPILED_LEFT:
             return true; // Nothing to do here
         default:
@@ -550,113 +1090,10 @@ define_compile(ARG)
     return false;
 }
 
-static inline bool is_cmp(op_type op)
-{
-    return op == OP_EQ || op == OP_NEQ || op == OP_LT || op == OP_GT
-        || op == OP_GEQ || op == OP_LEQ;
-}
-
 define_compile(OP)
 {
-    if (stage == STAGE_COMPILED_LEFT && node->value.op == OP_DIV)
-    {
-        // Multiply left operand by 1000
-        state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RAX));
-        state_add_ir_node(state, ir_node_new_binary(IR_MUL,
-                                                    ir_operand_reg(IR_REG_RAX),
-                                                    ir_operand_imm(1000)));
-        state_add_ir_node(state, ir_node_new_push_reg(IR_REG_RAX));
-        return true;
-    }
-
-    if (stage != STAGE_COMPILED_RIGHT) return true; // Nothing to do here
-
-    if (node->value.op == OP_NOT)
-    {
-        const ir_operand stack_top = {.flags = IR_OPERAND_REG | IR_OPERAND_MEM,
-                                      .reg   = IR_REG_RSP };
-
-        state_add_ir_node(state, ir_node_new_binary(IR_NOT, stack_top, {}));
-        state_add_ir_node(state, ir_node_new_binary(IR_AND, stack_top,
-                                                    ir_operand_imm(1)));
-        return true;
-    }
-
-    if (node->value.op == OP_NEG)
-    {
-        ir_node* neg = ir_node_new_empty();
-        neg->is_valid = true;
-        neg->operation = IR_NEG;
-        neg->operand1 = {.flags = IR_OPERAND_REG | IR_OPERAND_MEM,
-                         .reg   = IR_REG_RSP };
-        state_add_ir_node(state, neg);
-        return true;
-    }
-
-    state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RBX));
-    state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RAX));
-
-    ir_operand op1 = ir_operand_reg(IR_REG_RAX);
-    ir_operand op2 = ir_operand_reg(IR_REG_RBX);
-    ir_node* cmov = NULL;
-
-    if (is_cmp(node->value.op))
-    {
-        state_add_ir_node(state, ir_node_new_binary(IR_XOR,
-                                                ir_operand_reg(IR_REG_RDX),
-                                                ir_operand_reg(IR_REG_RDX)));
-        state_add_ir_node(state, ir_node_new_binary(IR_CMP, op1, op2));
-        state_add_ir_node(state, ir_node_new_binary(IR_MOV, op1,
-                                                    ir_operand_imm(1)));
-        cmov = ir_node_new_binary(IR_CMOV, ir_operand_reg(IR_REG_RDX), op1);
-        state_add_ir_node(state, cmov);
-        state_add_ir_node(state, ir_node_new_binary(IR_MOV, op1,
-                                                ir_operand_reg(IR_REG_RDX)));
-    }
-
-    switch (node->value.op)
-    {
-    case OP_ADD:
-        state_add_ir_node(state, ir_node_new_binary(IR_ADD, op1, op2));
-        break;
-    case OP_SUB:
-        state_add_ir_node(state, ir_node_new_binary(IR_SUB, op1, op2));
-        break;
-    case OP_AND:
-        state_add_ir_node(state, ir_node_new_binary(IR_AND, op1, op2));
-        break;
-    case OP_OR:
-        state_add_ir_node(state, ir_node_new_binary(IR_OR, op1, op2));
-        break;
-
-    case OP_MUL:
-        state_add_ir_node(state, ir_node_new_binary(IR_MUL, op1, op2));
-        state_add_ir_node(state, ir_node_new_binary(IR_MOV, op2,
-                                                    ir_operand_imm(1000)));
-    /* fallthrough */
-    case OP_DIV:
-        state_add_ir_node(state, ir_node_new_binary(IR_XOR,
-                                                ir_operand_reg(IR_REG_RDX),
-                                                ir_operand_reg(IR_REG_RDX)));
-        state_add_ir_node(state, ir_node_new_binary(IR_DIV, op2, {}));
-        break;
-
-    case OP_LT:  cmov->flags = IR_COND_LESS;        break;
-    case OP_GT:  cmov->flags = IR_COND_GREATER;     break;
-    case OP_LEQ: cmov->flags = IR_COND_NOT_GREATER; break;
-    case OP_GEQ: cmov->flags = IR_COND_NOT_LESS;    break;
-    case OP_EQ:  cmov->flags = IR_COND_EQUAL;       break;
-    case OP_NEQ: cmov->flags = IR_COND_NOT_EQUAL;   break;
-
-    case OP_NOT:
-    case OP_NEG:
-    default:
-        LOG_ASSERT(0 && "Unreachable code", return false);
-        return false;
-    }
-
-    state_add_ir_node(state, ir_node_new_push_reg(IR_REG_RAX));
-    return true;
+    LOG_ASSERT(0 && "Unreachable code", return false);
+    return false; /* expressions are compiled by compile_expression() */
 }
 
 define_compile(SEQ)
@@ -670,73 +1107,91 @@ define_compile(ASS)
 {
     if (stage != STAGE_COMPILED_RIGHT) return true; // Nothing to do here
 
-    long addr = 0;
-    bool is_global = false;
-    bool exists = table_stack_find_var(&state->name_scope, node->value.name,
-                                        &is_global, &addr);
-
-    AST_ASSERT(exists, "Undefined reference to variable '%s'.", node->value.name);
+    ir_operand var = {};
+    AST_ASSERT(get_var_operand(node->value.name, state, &var),
+               "Undefined reference to variable '%s'.", node->value.name);
 
     ir_node* pop = ir_node_new_empty();
     pop->is_valid = true;
     pop->operation = IR_POP;
-    pop->operand1 = {.flags = IR_OPERAND_MEM | IR_OPERAND_IMM,
-                      .reg = IR_REG_NONE,
-                      .immediate = addr };
-    if (!is_global)
-    {
-        pop->operand1.flags |= IR_OPERAND_REG;
-        pop->operand1.reg = IR_REG_RBP;
-        pop->operand1.immediate *= -1; // Stack grows in opposite direction
-    }
+    pop->operand1 = var;
     state_add_ir_node(state, pop);
 
     return true;
 }
 
+/*
+    Loops are rotated: condition is checked once before the loop to skip it
+    entirely, and then at the end of every iteration with a jump back to the
+    loop body. This way every iteration executes a single branch.
+
+    Globals modified by loop of leaf function can be cached in registers.
+    They are loaded before the entry check and stored back after the loop,
+    where both exits meet.
+*/
+
+static void compile_cached_globals(const ast_node* loop,
+                                   compilation_state* state, bool is_load)
+{
+    for (size_t i = 0; i < state->var_regs.var_cnt; ++i)
+    {
+        const var_register* var = &state->var_regs.vars[i];
+        if (!var->is_global || var->decl != loop || var->reg == IR_REG_NONE)
+            continue;
+
+        ir_operand mem = {};
+        if (!get_var_operand(var->name, state, &mem))
+            continue;   // Undefined variable is reported by its user
+
+        const ir_operand reg = ir_operand_reg(var->reg);
+        state_add_ir_node(state, is_load
+                                    ? ir_node_new_binary(IR_MOV, reg, mem)
+                                    : ir_node_new_binary(IR_MOV, mem, reg));
+    }
+}
+
 define_compile(WHILE)
 {
-    if (stage == STAGE_COMPILED_LEFT && node->left->type == NODE_CALL)
-        memset(state->ir_tail, 0, sizeof(*state->ir_tail));
-    ir_node* start_node = NULL;
+    ir_node* body_node = NULL;
     ir_node* jmp_node = NULL;
     ir_node* end_node = NULL;
+    ir_cond_flags cond = IR_COND_NONE;
     switch (stage)
     {
-    case STAGE_COMPILING_LEFT:
-        start_node = ir_node_new_empty();
-        state_add_ir_node(state, start_node);
-        ir_stack_push(&state->ir_stack, start_node);
+    case STAGE_COMPILING_LEFT:  // Jump to end is added by condition
+        if (!state->cached_loop)
+        {
+            compile_cached_globals(node, state, true);
+            state->cached_loop = node;
+        }
         return true;
     case STAGE_COMPILED_LEFT:
-        state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RAX));
-        state_add_ir_node(state, ir_node_new_binary(IR_TEST,
-                                                ir_operand_reg(IR_REG_RAX),
-                                                ir_operand_reg(IR_REG_RAX)));
-        jmp_node = ir_node_new_empty();
-        jmp_node->is_valid = true;
-        jmp_node->operation = IR_JMP;
-        jmp_node->flags = IR_COND_EQUAL;        // Jump to end if 0
-        state_add_ir_node(state, jmp_node);
-        ir_stack_push(&state->ir_stack, jmp_node);
+        body_node = ir_node_new_empty();
+        state_add_ir_node(state, body_node);
+        ir_stack_push(&state->ir_stack, body_node);
         return true;
     case STAGE_COMPILING_RIGHT:
         return true;
     case STAGE_COMPILED_RIGHT:
-        end_node = ir_node_new_empty();
-        jmp_node = ir_stack_top(&state->ir_stack);
+        body_node = ir_stack_top(&state->ir_stack);
         ir_stack_pop(&state->ir_stack);
-        jmp_node->jump_target = end_node;       // Set target for start jump
 
-        start_node = ir_stack_top(&state->ir_stack);
+        STEP(compile_cond_flags(node->left, state, &cond));
+        jmp_node = ir_node_new_jmp(body_node);
+        jmp_node->flags = cond;                 // Repeat if condition is true
+        state_add_ir_node(state, jmp_node);
+
+        end_node = ir_node_new_empty();
+        jmp_node = ir_stack_top(&state->ir_stack);
         ir_stack_pop(&state->ir_stack);
-        jmp_node = ir_node_new_empty();
-        jmp_node->is_valid = true;
-        jmp_node->operation = IR_JMP;
-        jmp_node->jump_target = start_node;     // Set target for main loop jump
+        jmp_node->jump_target = end_node;       // Set target for entry check
 
-        state_add_ir_node(state, jmp_node);
         state_add_ir_node(state, end_node);
+        if (state->cached_loop == node)
+        {
+            state->cached_loop = NULL;
+            compile_cached_globals(node, state, false);
+        }
         return true;
     default:
         LOG_ASSERT(0 && "Unreachable code", return false);
@@ -763,17 +1218,7 @@ define_compile(BRANCH)
     ir_node* end_node = NULL;
     switch (stage)
     {
-    case STAGE_COMPILING_LEFT:
-        state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RAX));
-        state_add_ir_node(state, ir_node_new_binary(IR_TEST,
-                                                ir_operand_reg(IR_REG_RAX),
-                                                ir_operand_reg(IR_REG_RAX)));
-        jmp_node = ir_node_new_empty();
-        jmp_node->is_valid = true;
-        jmp_node->operation = IR_JMP;
-        jmp_node->flags = IR_COND_EQUAL;        // Jump to false if 0
-        state_add_ir_node(state, jmp_node);
-        ir_stack_push(&state->ir_stack, jmp_node);
+    case STAGE_COMPILING_LEFT:  // Jump to 'else' is added by IF condition
         return true;
     case STAGE_COMPILED_LEFT:
         else_node = ir_node_new_empty();
@@ -809,26 +1254,8 @@ define_compile(BRANCH)
 
 define_compile(CALL)
 {
-    if (stage != STAGE_COMPILED_RIGHT) return true; // Nothing to do here
-    const function* func = func_array_find_func(&state->functions, node->value.name);
-    AST_ASSERT(func != NULL, "Function '%s' was not defined.", node->value.name);
-    size_t args = 0;
-    ast_node* arg = node->right;
-    while(arg)
-    {
-        args++;
-        arg = arg->right;
-    }
-    AST_ASSERT(func->arg_cnt == args,
-        "Function '%s' expects %zu arguments, but %zu were given.", node->value.name, func->arg_cnt, args);
-    state_add_ir_node(state, ir_node_new_call(func->ir_list_head));
-    if (args > 0)   // Free argument space
-        state_add_ir_node(state, ir_node_new_binary(IR_ADD,
-                                                ir_operand_reg(IR_REG_RSP),
-                                                ir_operand_imm((long)(8*args))));
-    state_add_ir_node(state, ir_node_new_push_reg(IR_REG_RAX));
-
-    return true;
+    LOG_ASSERT(0 && "Unreachable code", return false);
+    return false; /* expressions are compiled by compile_expression() */
 }
 
 define_compile(PAR)
@@ -856,43 +1283,1085 @@ define_compile(RET)
 
 define_compile(CONST)
 {
-    if (stage != STAGE_COMPILED_RIGHT) return true; // Nothing to do here
+    LOG_ASSERT(0 && "Unreachable code", return false);
+    return false; /* expressions are compiled by compile_expression() */
+}
+
+define_compile(VAR)
+{
+    LOG_ASSERT(0 && "Unreachable code", return false);
+    return false; /* expressions are compiled by compile_expression() */
+}
+
+define_compile(CMP) { return false; }
+define_compile(LOGIC) { return false; }
 
-    state_add_ir_node(state, ir_node_new_binary(IR_MOV,
-                                ir_operand_reg(IR_REG_RAX),
-                                ir_operand_imm((long)(node->value.num*1000))));
+
+/*
+    Expressions are compiled with plain recursive descent. Every subtree is
+    evaluated into a register from `expr_regs`, and the order of operand
+    evaluation is chosen by Sethi-Ullman numbering, so that the hardware stack
+    is only used when the tree is deeper than the register file.
+
+    RAX and RDX are not allocated, as they are implicit operands of IDIV.
+    R11 is used as scratch register for spilled operands. Registers from
+    `call_arg_regs` and `var_saved_regs` are not allocated, as they hold
+    variables and function arguments.
+*/
+
+static const ir_reg expr_regs[] = {
+    IR_REG_RCX, IR_REG_R8,  IR_REG_R9,  IR_REG_R10
+};
+
+static const size_t expr_reg_cnt = sizeof(expr_regs) / sizeof(*expr_regs);
+
+static const ir_reg expr_scratch_reg = IR_REG_R11;
+
+static const ir_reg expr_xmm_regs[] = {
+    IR_REG_XMM0,  IR_REG_XMM1,  IR_REG_XMM2,  IR_REG_XMM3,
+    IR_REG_XMM4,  IR_REG_XMM5,  IR_REG_XMM6,  IR_REG_XMM7,
+    IR_REG_XMM8,  IR_REG_XMM9,  IR_REG_XMM10, IR_REG_XMM11,
+    IR_REG_XMM12, IR_REG_XMM13, IR_REG_XMM14
+};
+
+static const size_t expr_xmm_reg_cnt =
+                            sizeof(expr_xmm_regs) / sizeof(*expr_xmm_regs);
+
+static const ir_reg expr_xmm_scratch_reg = IR_REG_XMM15;
+
+static inline ir_reg expr_reg(const compilation_state* state, size_t idx)
+{
+    return state->use_double ? expr_xmm_regs[idx] : expr_regs[idx];
+}
+
+static inline size_t expr_reg_count(const compilation_state* state)
+{
+    return state->use_double ? expr_xmm_reg_cnt : expr_reg_cnt;
+}
+
+static inline ir_reg expr_scratch(const compilation_state* state)
+{
+    return state->use_double ? expr_xmm_scratch_reg : expr_scratch_reg;
+}
+
+/* XMM registers cannot be pushed directly, RAX is used for transfer */
+static void compile_push_value(ir_reg reg, compilation_state* state)
+{
+    if (!state->use_double)
+    {
+        state_add_ir_node(state, ir_node_new_push_reg(reg));
+        return;
+    }
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ,
+                                                ir_operand_reg(IR_REG_RAX),
+                                                ir_operand_reg(reg)));
     state_add_ir_node(state, ir_node_new_push_reg(IR_REG_RAX));
-    return true;
 }
 
-define_compile(VAR)
+static void compile_pop_value(ir_reg reg, compilation_state* state)
 {
-    if (stage != STAGE_COMPILED_RIGHT) return true; // Nothing to do here
+    if (!state->use_double)
+    {
+        state_add_ir_node(state, ir_node_new_pop_reg(reg));
+        return;
+    }
+    state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RAX));
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ,
+                                                ir_operand_reg(reg),
+                                                ir_operand_reg(IR_REG_RAX)));
+}
+
+/* Move value between expression registers or from memory */
+static void compile_move_value(ir_reg dest, ir_operand src,
+                               compilation_state* state)
+{
+    state_add_ir_node(state, ir_node_new_binary(
+                                    state->use_double ? IR_MOVSD : IR_MOV,
+                                    ir_operand_reg(dest), src));
+}
+
+static bool compile_expr(const ast_node* node, compilation_state* state,
+                         size_t reg_idx);
+
+static bool compile_expression(const ast_node* node, compilation_state* state)
+{
+    STEP(compile_expr(node, state, 0));
+    compile_push_value(expr_reg(state, 0), state);
+    return true;
+}
 
+static bool get_var_operand(const char* name, compilation_state* state,
+                            ir_operand* operand)
+{
     long addr = 0;
     bool is_global = false;
-    bool exists = table_stack_find_var(&state->name_scope, node->value.name,
-                                        &is_global, &addr);
+    if (!table_stack_find_var(&state->name_scope, name, &is_global, &addr))
+        return false;
 
-    AST_ASSERT(exists, "Undefined reference to variable '%s'.", node->value.name);
+    ir_reg reg = IR_REG_NONE;
+    if (!is_global && addr > 0)
+    {
+        const var_slot* slot = &state->slots[addr / 8 - 1];
+        if (slot->reg == IR_REG_NONE)
+            addr = slot->offset;
+        reg = slot->reg;
+    }
+    else if (is_global && state->cached_loop)
+        reg = reg_allocation_find_global(&state->var_regs,
+                                         state->cached_loop, name);
+    if (reg != IR_REG_NONE)
+    {
+        *operand = ir_operand_reg(reg);
+        return true;
+    }
 
-    ir_node* push = ir_node_new_empty();
-    push->is_valid = true;
-    push->operation = IR_PUSH;
-    push->operand1 = {.flags = IR_OPERAND_MEM | IR_OPERAND_IMM,
-                      .reg = IR_REG_NONE,
-                      .immediate = addr };
+    *operand = {.flags = IR_OPERAND_MEM | IR_OPERAND_IMM,
+                .reg = IR_REG_NONE,
+                .immediate = addr };
     if (!is_global)
     {
-        push->operand1.flags |= IR_OPERAND_REG;
-        push->operand1.reg = IR_REG_RBP;
-        push->operand1.immediate *= -1; // Stack grows in opposite direction
+        operand->flags |= IR_OPERAND_REG;
+        operand->reg = IR_REG_RBP;
+        operand->immediate *= -1; // Stack grows in opposite direction
+    }
+    return true;
+}
+
+static inline bool is_cmp(op_type op)
+{
+    return op == OP_EQ || op == OP_NEQ || op == OP_LT || op == OP_GT
+        || op == OP_GEQ || op == OP_LEQ;
+}
+
+static inline bool is_unary(op_type op)
+{
+    return op == OP_NOT || op == OP_NEG;
+}
+
+static inline bool is_commutative(op_type op)
+{
+    return op == OP_ADD || op == OP_MUL || op == OP_AND || op == OP_OR;
+}
+
+static inline long const_value(const ast_node* node,
+                               const compilation_state* state)
+{
+    if (state->use_double)      // Bit pattern of IEEE-754 double
+    {
+        long bits = 0;
+        memcpy(&bits, &node->value.num, sizeof(bits));
+        return bits;
+    }
+    // Round to nearest: decimal fractions are inexact, 1.001 * 1000 < 1001
+    return lround(node->value.num * (double) state->fixed_scale);
+}
+
+static inline bool fits_imm32(long value)
+{
+    return INT32_MIN <= value && value <= INT32_MAX;
+}
+
+/**
+ * @brief Check whether node can be used as operand of an instruction
+ * without loading it into register first
+ */
+static inline bool is_direct_operand(const ast_node* node,
+                                     const compilation_state* state)
+{
+    if (node->type == NODE_VAR)
+        return true;
+    if (node->type == NODE_CONST)   // SSE instructions have no immediates
+        return !state->use_double && fits_imm32(const_value(node, state));
+    return false;
+}
+
+/**
+ * @brief Check whether expression calls function defined in program, which
+ * may change variables or produce output
+ */
+static bool contains_user_call(const ast_node* node,
+                               const compilation_state* state)
+{
+    if (node == NULL)
+        return false;
+    if (node->type == NODE_CALL)
+    {
+        const function* func = func_array_find_func(&state->functions,
+                                                    node->value.name);
+        if (func && func->node)
+            return true;
     }
+    return contains_user_call(node->left,  state)
+        || contains_user_call(node->right, state);
+}
+
+/**
+ * @brief Check whether result or effect of expression depends on the moment
+ * it is evaluated at
+ */
+static bool depends_on_state(const ast_node* node,
+                             const compilation_state* state)
+{
+    if (node == NULL)
+        return false;
+    if (node->type == NODE_VAR)
+        return true;
+    if (node->type == NODE_CALL && !is_intrinsic_call(node, state))
+        return true;
+    return depends_on_state(node->left,  state)
+        || depends_on_state(node->right, state);
+}
 
-    state_add_ir_node(state, push);
+/**
+ * @brief Check whether operands must be evaluated in source order, because
+ * one of them calls a function, which may affect the other one
+ */
+static bool is_order_fixed(const ast_node* left, const ast_node* right,
+                           const compilation_state* state)
+{
+    return (contains_user_call(left,  state) && depends_on_state(right, state))
+        || (contains_user_call(right, state) && depends_on_state(left,  state));
+}
+
+/**
+ * @brief Count registers needed to evaluate expression without spills
+ */
+static size_t expr_reg_need(const ast_node* node,
+                            const compilation_state* state)
+{
+    if (is_intrinsic_call(node, state))
+        return expr_reg_need(node->right->left, state);
 
+    if (node->type == NODE_CALL)
+        return expr_reg_count(state);   // Call clobbers every register, so it is
+                                // better to evaluate it before anything else
+
+    if (node->type != NODE_OP)
+        return 1;
+
+    if (is_unary(node->value.op))
+        return expr_reg_need(node->right, state);
+
+    size_t left  = expr_reg_need(node->left, state);
+    size_t right = is_direct_operand(node->right, state)
+                            ? 0 : expr_reg_need(node->right, state);
+    if (left == right)
+        return left + 1;
+    return left > right ? left : right;
+}
+
+/**
+ * @brief Load value of direct operand into `operand`
+ */
+static bool get_direct_operand(const ast_node* node, compilation_state* state,
+                               ir_operand* operand)
+{
+    if (node->type == NODE_CONST)
+    {
+        *operand = ir_operand_imm(const_value(node, state));
+        return true;
+    }
+
+    AST_ASSERT(get_var_operand(node->value.name, state, operand),
+               "Undefined reference to variable '%s'.", node->value.name);
     return true;
 }
 
-define_compile(CMP) { return false; }
-define_compile(LOGIC) { return false; }
+static inline ir_cond_flags get_cmp_cond(op_type op,
+                                         const compilation_state* state)
+{
+    const bool fp = state->use_double;  // UCOMISD sets flags as unsigned CMP
+    switch (op)
+    {
+    case OP_LT:  return fp ? IR_COND_BELOW     : IR_COND_LESS;
+    case OP_GT:  return fp ? IR_COND_ABOVE     : IR_COND_GREATER;
+    case OP_LEQ: return fp ? IR_COND_NOT_ABOVE : IR_COND_NOT_GREATER;
+    case OP_GEQ: return fp ? IR_COND_NOT_BELOW : IR_COND_NOT_LESS;
+    case OP_EQ:  return IR_COND_EQUAL;
+    case OP_NEQ: return IR_COND_NOT_EQUAL;
+
+    case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_NEG:
+    case OP_AND: case OP_OR:  case OP_NOT:
+    default:
+        return IR_COND_NONE;
+    }
+}
+
+static inline bool is_pow2(unsigned long value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static inline unsigned ilog2(unsigned long value)
+{
+    unsigned result = 0;
+    while (value >>= 1)
+        ++result;
+    return result;
+}
+
+/**
+ * @brief Magic number for signed division by constant
+ * (H. S. Warren, "Hacker's Delight", 10-4)
+ */
+struct div_magic
+{
+    long     multiplier;
+    unsigned shift;
+};
+
+static div_magic get_div_magic(unsigned long divisor)
+{
+    const unsigned long two63 = 1ul << 63;
+
+    unsigned long anc = two63 - 1 - two63 % divisor;    // |nc|
+    unsigned long q1 = two63 / anc, r1 = two63 - q1*anc;
+    unsigned long q2 = two63 / divisor, r2 = two63 - q2*divisor;
+    unsigned long delta = 0;
+    unsigned p = 63;
+    do
+    {
+        ++p;
+        q1 *= 2; r1 *= 2;
+        if (r1 >= anc) { ++q1; r1 -= anc; }
+        q2 *= 2; r2 *= 2;
+        if (r2 >= divisor) { ++q2; r2 -= divisor; }
+        delta = divisor - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    return { .multiplier = (long) (q2 + 1), .shift = p - 64 };
+}
+
+/**
+ * @brief Emit `dest := dest * factor` for integer `factor`, using shifts
+ * and LEA where possible
+ */
+static void compile_int_mul(ir_reg dest, long factor, compilation_state* state)
+{
+    const ir_operand dst = ir_operand_reg(dest);
+    const unsigned long abs_factor = factor < 0 ? -(unsigned long) factor
+                                                : (unsigned long) factor;
+
+    if (factor == 0)
+    {
+        state_add_ir_node(state, ir_node_new_binary(IR_XOR, dst, dst));
+        return;
+    }
+
+    if (is_pow2(abs_factor))
+    {
+        if (abs_factor > 1)
+            state_add_ir_node(state, ir_node_new_binary(IR_SHL, dst,
+                                        ir_operand_imm(ilog2(abs_factor))));
+    }
+    else if (abs_factor == 3 || abs_factor == 5 || abs_factor == 9)
+    {
+        ir_operand index = ir_operand_reg(dest);
+        index.flags |= IR_OPERAND_IMM;
+        index.immediate = (long) abs_factor - 1;    // dest + dest*scale
+        state_add_ir_node(state, ir_node_new_binary(IR_LEA, dst, index));
+    }
+    else
+    {
+        state_add_ir_node(state, ir_node_new_binary(IR_MUL, dst,
+                                                    ir_operand_imm(factor)));
+        return;
+    }
+
+    if (factor < 0)
+        state_add_ir_node(state, ir_node_new_binary(IR_NEG, dst, {}));
+}
+
+/**
+ * @brief Emit `dest := dest / divisor` (rounded towards zero) for
+ * non-zero integer `divisor` without using IDIV. Clobbers RAX and RDX.
+ */
+static void compile_int_div(ir_reg dest, long divisor,
+                            compilation_state* state)
+{
+    const ir_operand dst = ir_operand_reg(dest);
+    const ir_operand acc = ir_operand_reg(IR_REG_RAX);
+    const ir_operand hi  = ir_operand_reg(IR_REG_RDX);
+    const unsigned long abs_divisor = divisor < 0 ? -(unsigned long) divisor
+                                                  : (unsigned long) divisor;
+
+    if (is_pow2(abs_divisor) && abs_divisor > 1)
+    {
+        // Add (2^k - 1) to negative dividends, so that shift rounds to zero
+        const unsigned k = ilog2(abs_divisor);
+        state_add_ir_node(state, ir_node_new_binary(IR_MOV, acc, dst));
+        state_add_ir_node(state, ir_node_new_binary(IR_SAR, acc,
+                                                    ir_operand_imm(63)));
+        state_add_ir_node(state, ir_node_new_binary(IR_SHR, acc,
+                                                    ir_operand_imm(64 - k)));
+        state_add_ir_node(state, ir_node_new_binary(IR_ADD, dst, acc));
+        state_add_ir_node(state, ir_node_new_binary(IR_SAR, dst,
+                                                    ir_operand_imm(k)));
+    }
+    else if (abs_divisor > 1)
+    {
+        const div_magic magic = get_div_magic(abs_divisor);
+        state_add_ir_node(state, ir_node_new_binary(IR_MOV, acc,
+                                        ir_operand_imm(magic.multiplier)));
+        state_add_ir_node(state, ir_node_new_binary(IR_MULH, dst, {}));
+        if (magic.multiplier < 0)
+            state_add_ir_node(state, ir_node_new_binary(IR_ADD, hi, dst));
+        if (magic.shift > 0)
+            state_add_ir_node(state, ir_node_new_binary(IR_SAR, hi,
+                                        ir_operand_imm(magic.shift)));
+        // Add 1 to negative quotients
+        state_add_ir_node(state, ir_node_new_binary(IR_SHR, dst,
+                                                    ir_operand_imm(63)));
+        state_add_ir_node(state, ir_node_new_binary(IR_ADD, dst, hi));
+    }
+
+    if (divisor < 0)
+        state_add_ir_node(state, ir_node_new_binary(IR_NEG, dst, {}));
+}
+
+/**
+ * @brief Set ZF if double in `src` is zero (either +0.0 or -0.0).
+ * Value is transferred through general-purpose register `tmp`.
+ */
+static void compile_double_to_flags(ir_reg src, ir_reg tmp,
+                                    compilation_state* state)
+{
+    const ir_operand gpr = ir_operand_reg(tmp);
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, gpr,
+                                                ir_operand_reg(src)));
+    state_add_ir_node(state, ir_node_new_binary(IR_SHL, gpr,
+                                                ir_operand_imm(1)));
+}
+
+/**
+ * @brief Emit `dest := (double) (cond ? 1 : 0)` using RAX
+ */
+static void compile_cond_to_double(ir_reg dest, ir_cond_flags cond,
+                                   compilation_state* state)
+{
+    const ir_operand acc = ir_operand_reg(IR_REG_RAX);
+
+    ir_node* setcc = ir_node_new_binary(IR_SETCC, acc, {});
+    setcc->flags = cond;
+    state_add_ir_node(state, setcc);
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVZX, acc, acc));
+    state_add_ir_node(state, ir_node_new_binary(IR_CVTSI2SD,
+                                                ir_operand_reg(dest), acc));
+}
+
+static bool compile_unary_op_double(op_type op, ir_reg dest,
+                                    compilation_state* state)
+{
+    const ir_operand dst     = ir_operand_reg(dest);
+    const ir_operand acc     = ir_operand_reg(IR_REG_RAX);
+    const ir_operand scratch = ir_operand_reg(expr_scratch_reg);
+
+    if (op == OP_NOT)
+    {
+        compile_double_to_flags(dest, IR_REG_RAX, state);
+        compile_cond_to_double(dest, IR_COND_EQUAL, state);
+        return true;
+    }
+
+    // Flip sign bit
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, acc, dst));
+    state_add_ir_node(state, ir_node_new_binary(IR_MOV, scratch,
+                                                ir_operand_imm(INT64_MIN)));
+    state_add_ir_node(state, ir_node_new_binary(IR_XOR, acc, scratch));
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, dst, acc));
+    return true;
+}
+
+/**
+ * @brief Emit `dest := dest <op> src` for doubles, where `dest` is XMM
+ * register and `src` is XMM register or memory. Logical operations
+ * produce 1.0 or 0.0.
+ */
+static bool compile_binary_op_double(op_type op, ir_reg dest, ir_operand src,
+                                     compilation_state* state,
+                                     bool materialize)
+{
+    const ir_operand dst     = ir_operand_reg(dest);
+    const ir_operand acc     = ir_operand_reg(IR_REG_RAX);
+    const ir_operand scratch = ir_operand_reg(expr_scratch_reg);
+
+    switch (op)
+    {
+    case OP_ADD:
+        state_add_ir_node(state, ir_node_new_binary(IR_ADDSD, dst, src));
+        return true;
+    case OP_SUB:
+        state_add_ir_node(state, ir_node_new_binary(IR_SUBSD, dst, src));
+        return true;
+    case OP_MUL:
+        state_add_ir_node(state, ir_node_new_binary(IR_MULSD, dst, src));
+        return true;
+    case OP_DIV:
+        state_add_ir_node(state, ir_node_new_binary(IR_DIVSD, dst, src));
+        return true;
+
+    case OP_AND:
+    case OP_OR:
+    {
+        compile_double_to_flags(dest, IR_REG_RAX, state);
+        ir_node* setcc = ir_node_new_binary(IR_SETCC, acc, {});
+        setcc->flags = IR_COND_NOT_EQUAL;
+        state_add_ir_node(state, setcc);
+        state_add_ir_node(state, ir_node_new_binary(IR_MOVZX, acc, acc));
+
+        if (src.flags == IR_OPERAND_REG)
+            state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, scratch, src));
+        else
+            state_add_ir_node(state, ir_node_new_binary(IR_MOV, scratch, src));
+        state_add_ir_node(state, ir_node_new_binary(IR_SHL, scratch,
+                                                    ir_operand_imm(1)));
+        setcc = ir_node_new_binary(IR_SETCC, scratch, {});
+        setcc->flags = IR_COND_NOT_EQUAL;
+        state_add_ir_node(state, setcc);
+        state_add_ir_node(state, ir_node_new_binary(IR_MOVZX, scratch,
+                                                    scratch));
+
+        state_add_ir_node(state, ir_node_new_binary(
+                                        op == OP_AND ? IR_AND : IR_OR,
+                                        acc, scratch));
+        compile_cond_to_double(dest, IR_COND_NOT_EQUAL, state);
+        return true;
+    }
+
+    case OP_LT:
+    case OP_GT:
+    case OP_LEQ:
+    case OP_GEQ:
+    case OP_EQ:
+    case OP_NEQ:
+        state_add_ir_node(state, ir_node_new_binary(IR_UCOMISD, dst, src));
+        if (materialize)
+            compile_cond_to_double(dest, get_cmp_cond(op, state), state);
+        return true;
+
+    case OP_NOT:
+    case OP_NEG:
+    default:
+        LOG_ASSERT(0 && "Unreachable code", return false);
+        return false;
+    }
+}
+
+/**
+ * @brief Emit `dest := dest <op> src`, where `dest` is a register. If
+ * `materialize` is `false`, comparisons only set flags.
+ */
+static bool compile_binary_op(op_type op, ir_reg dest, ir_operand src,
+                              compilation_state* state, bool materialize)
+{
+    const ir_operand dst     = ir_operand_reg(dest);
+    const ir_operand acc     = ir_operand_reg(IR_REG_RAX);
+    const ir_operand scratch = ir_operand_reg(expr_scratch_reg);
+    const long       scale   = state->fixed_scale;
+
+    if (state->use_double)
+        return compile_binary_op_double(op, dest, src, state, materialize);
+
+    switch (op)
+    {
+    case OP_ADD:
+        state_add_ir_node(state, ir_node_new_binary(IR_ADD, dst, src));
+        return true;
+    case OP_SUB:
+        state_add_ir_node(state, ir_node_new_binary(IR_SUB, dst, src));
+        return true;
+    case OP_AND:
+        state_add_ir_node(state, ir_node_new_binary(IR_AND, dst, src));
+        return true;
+    case OP_OR:
+        state_add_ir_node(state, ir_node_new_binary(IR_OR, dst, src));
+        return true;
+
+    case OP_MUL:
+        if (src.flags == IR_OPERAND_IMM && src.immediate % scale == 0)
+        {
+            compile_int_mul(dest, src.immediate / scale, state);
+            return true;
+        }
+        // Rescale, rounding towards zero like IDIV in OP_DIV, so that
+        // product does not depend on whether operands are constant
+        state_add_ir_node(state, ir_node_new_binary(IR_MUL, dst, src));
+        compile_int_div(dest, scale, state);
+        return true;
+    case OP_DIV:
+        if (src.flags == IR_OPERAND_IMM && src.immediate % scale == 0
+                                        && src.immediate != 0)
+        {
+            compile_int_div(dest, src.immediate / scale, state);
+            return true;
+        }
+        if (state->fixed_shift)
+            state_add_ir_node(state, ir_node_new_binary(IR_SHL, dst,
+                                        ir_operand_imm(state->fixed_shift)));
+        else
+            state_add_ir_node(state, ir_node_new_binary(IR_MUL, dst,
+                                                    ir_operand_imm(scale)));
+        if (src.flags == IR_OPERAND_IMM && src.immediate != 0)
+        {
+            compile_int_div(dest, src.immediate, state);
+            return true;
+        }
+        if (src.flags == IR_OPERAND_IMM)    // IDIV has no immediate form
+        {
+            state_add_ir_node(state, ir_node_new_binary(IR_MOV, scratch, src));
+            src = scratch;
+        }
+        break;
+
+    case OP_LT:
+    case OP_GT:
+    case OP_LEQ:
+    case OP_GEQ:
+    case OP_EQ:
+    case OP_NEQ:
+    {
+        state_add_ir_node(state, ir_node_new_binary(IR_CMP, dst, src));
+        if (!materialize)
+            return true;
+
+        ir_node* setcc = ir_node_new_binary(IR_SETCC, dst, {});
+        setcc->flags = get_cmp_cond(op, state);
+        state_add_ir_node(state, setcc);
+        state_add_ir_node(state, ir_node_new_binary(IR_MOVZX, dst, dst));
+        return true;
+    }
+
+    case OP_NOT:
+    case OP_NEG:
+    default:
+        LOG_ASSERT(0 && "Unreachable code", return false);
+        return false;
+    }
+
+    // Divide RAX by `src` (CQO is emitted together with IDIV)
+    state_add_ir_node(state, ir_node_new_binary(IR_MOV, acc, dst));
+    state_add_ir_node(state, ir_node_new_binary(IR_DIV, src, {}));
+    state_add_ir_node(state, ir_node_new_binary(IR_MOV, dst, acc));
+    return true;
+}
+
+static bool compile_expr_unary(const ast_node* node, compilation_state* state,
+                               size_t reg_idx)
+{
+    const ir_operand dst = ir_operand_reg(expr_reg(state, reg_idx));
+
+    STEP(compile_expr(node->right, state, reg_idx));
+
+    if (state->use_double)
+        return compile_unary_op_double(node->value.op, dst.reg, state);
+
+    if (node->value.op == OP_NOT)
+    {
+        state_add_ir_node(state, ir_node_new_binary(IR_NOT, dst, {}));
+        state_add_ir_node(state, ir_node_new_binary(IR_AND, dst,
+                                                    ir_operand_imm(1)));
+        return true;
+    }
+
+    state_add_ir_node(state, ir_node_new_binary(IR_NEG, dst, {}));
+    return true;
+}
+
+static bool compile_expr_binary(const ast_node* node, compilation_state* state,
+                                size_t reg_idx, bool materialize)
+{
+    const ir_reg dest = expr_reg(state, reg_idx);
+    op_type op = node->value.op;
+
+    const ast_node* left  = node->left;
+    const ast_node* right = node->right;
+
+    const bool order_fixed = is_order_fixed(left, right, state);
+
+    if (is_commutative(op) && is_direct_operand(left, state)
+                           && !is_direct_operand(right, state)
+                           && !order_fixed)
+    {
+        const ast_node* tmp = left;
+        left  = right;
+        right = tmp;
+    }
+
+    if (is_direct_operand(right, state))   // Right operand needs no register
+    {
+        ir_operand src = {};
+        STEP(compile_expr(left, state, reg_idx));
+        STEP(get_direct_operand(right, state, &src));
+        return compile_binary_op(op, dest, src, state, materialize);
+    }
+
+    const bool left_first = order_fixed
+                         || expr_reg_need(left, state) >= expr_reg_need(right, state);
+    const ast_node* first  = left_first ? left  : right;
+    const ast_node* second = left_first ? right : left;
+
+    STEP(compile_expr(first, state, reg_idx));
+
+    ir_reg first_reg  = dest;
+    ir_reg second_reg = IR_REG_NONE;
+    if (reg_idx + 1 < expr_reg_count(state))
+    {
+        second_reg = expr_reg(state, reg_idx + 1);
+        STEP(compile_expr(second, state, reg_idx + 1));
+    }
+    else    // Out of registers, spill first operand
+    {
+        second_reg = expr_scratch(state);
+        compile_push_value(dest, state);
+        STEP(compile_expr(second, state, reg_idx));
+        compile_move_value(second_reg, ir_operand_reg(dest), state);
+        compile_pop_value(dest, state);
+    }
+
+    if (left_first)
+        return compile_binary_op(op, first_reg, ir_operand_reg(second_reg),
+                                 state, materialize);
+
+    STEP(compile_binary_op(op, second_reg, ir_operand_reg(first_reg),
+                           state, materialize));
+    compile_move_value(dest, ir_operand_reg(second_reg), state);
+    return true;
+}
+
+/**
+ * @brief Check call arguments and put them where callee expects them.
+ * Register arguments evaluated before the last nested call are also left
+ * on stack under the stack arguments.
+ *
+ * @param[out] pushed_regs  Number of register arguments left on stack
+ */
+static bool compile_call_args(const ast_node* node, const function* func,
+                              compilation_state* state, size_t* pushed_regs)
+{
+    size_t args = 0;
+    const ast_node* arg = node->right;
+    while(arg)
+    {
+        args++;
+        arg = arg->right;
+    }
+    AST_ASSERT(func->arg_cnt == args,
+        "Function '%s' expects %zu arguments, but %zu were given.", node->value.name, func->arg_cnt, args);
+
+    // Standard library functions take all arguments on stack
+    const size_t reg_args = func->node ? min_size(args, call_arg_reg_cnt) : 0;
+    const ir_op  arg_move = state->use_double ? IR_MOVQ : IR_MOV;
+
+    // Nested calls clobber argument registers, so register arguments
+    // evaluated before the last nested call are kept on stack and loaded
+    // right before the call
+    size_t arg_idx = 0;
+    *pushed_regs = 0;
+    for (arg = node->right; arg; arg = arg->right, ++arg_idx)
+        if (contains_call(arg->left, state))
+            *pushed_regs = min_size(arg_idx, reg_args);
+    const size_t pushed = *pushed_regs + args - reg_args;
+
+    arg_idx = 0;
+    for (arg = node->right; arg; arg = arg->right, ++arg_idx)
+    {
+        STEP(compile_expr(arg->left, state, 0));
+        if (arg_idx < *pushed_regs || arg_idx >= reg_args)
+            compile_push_value(expr_reg(state, 0), state);
+        else
+            state_add_ir_node(state, ir_node_new_binary(arg_move,
+                                ir_operand_reg(call_arg_regs[arg_idx]),
+                                ir_operand_reg(expr_reg(state, 0))));
+    }
+
+    for (size_t i = 0; i < *pushed_regs; ++i)
+    {
+        // mov reg, [rsp+8*(pushed-1-i)]
+        ir_operand slot = {
+            .flags = IR_OPERAND_MEM | IR_OPERAND_REG | IR_OPERAND_IMM,
+            .reg = IR_REG_RSP,
+            .immediate = 8 * (long)(pushed - 1 - i)
+        };
+        state_add_ir_node(state, ir_node_new_binary(IR_MOV,
+                                ir_operand_reg(call_arg_regs[i]), slot));
+    }
+
+    return true;
+}
+
+static bool compile_expr_call(const ast_node* node, compilation_state* state,
+                              size_t reg_idx)
+{
+    const function* func = func_array_find_func(&state->functions, node->value.name);
+    AST_ASSERT(func != NULL, "Function '%s' was not defined.", node->value.name);
+
+    // Save registers holding already evaluated operands
+    for (size_t i = 0; i < reg_idx; ++i)
+        compile_push_value(expr_reg(state, i), state);
+
+    size_t pushed_regs = 0;
+    STEP(compile_call_args(node, func, state, &pushed_regs));
+
+    state_add_ir_node(state, ir_node_new_call(func->ir_list_head));
+
+    // Free space of arguments, which were not removed by callee
+    const size_t left_args = func->node ? pushed_regs : func->arg_cnt;
+    if (left_args > 0)
+        state_add_ir_node(state, ir_node_new_binary(IR_ADD,
+                                            ir_operand_reg(IR_REG_RSP),
+                                            ir_operand_imm((long)(8*left_args))));
+    state_add_ir_node(state, ir_node_new_binary(
+                                state->use_double ? IR_MOVQ : IR_MOV,
+                                ir_operand_reg(expr_reg(state, reg_idx)),
+                                ir_operand_reg(IR_REG_RAX)));
+
+    for (size_t i = reg_idx; i > 0; --i)
+        compile_pop_value(expr_reg(state, i - 1), state);
+
+    return true;
+}
+
+/*
+    Square root is computed in place. Fixed-point number x is stored as
+    x * scale, and its root is sqrt(x) * scale = sqrt(x * scale * scale),
+    so stored value is multiplied by scale once before SQRTSD. Fixed-point
+    mode keeps no values in XMM registers, so any of them can be used.
+*/
+
+static bool compile_expr_sqrt(const ast_node* node, compilation_state* state,
+                              size_t reg_idx)
+{
+    AST_ASSERT(node->right != NULL && node->right->right == NULL,
+        "Function '%s' expects 1 argument.", node->value.name);
+
+    const ir_operand dst = ir_operand_reg(expr_reg(state, reg_idx));
+    STEP(compile_expr(node->right->left, state, reg_idx));
+
+    if (state->use_double)
+    {
+        state_add_ir_node(state, ir_node_new_binary(IR_SQRTSD, dst, dst));
+        return true;
+    }
+
+    const ir_operand value = ir_operand_reg(IR_REG_XMM0);
+    const ir_operand scale = ir_operand_reg(IR_REG_XMM1);
+    const ir_operand acc   = ir_operand_reg(IR_REG_RAX);
+    const double scale_value = (double) state->fixed_scale;
+    long scale_bits = 0;
+    memcpy(&scale_bits, &scale_value, sizeof(scale_bits));
+
+    state_add_ir_node(state, ir_node_new_binary(IR_MOV, acc,
+                                                ir_operand_imm(scale_bits)));
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, scale, acc));
+    // CVTSI2SD keeps upper half of destination, so it would wait for SQRTSD
+    // of previous root unless destination is overwritten first
+    state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, value, acc));
+    state_add_ir_node(state, ir_node_new_binary(IR_CVTSI2SD, value, dst));
+    state_add_ir_node(state, ir_node_new_binary(IR_MULSD, value, scale));
+    state_add_ir_node(state, ir_node_new_binary(IR_SQRTSD, value, value));
+    state_add_ir_node(state, ir_node_new_binary(IR_CVTSD2SI, dst, value));
+    return true;
+}
+
+/*
+    Return statement, whose value is a call to function defined in program,
+    does not need to keep current stack frame. Self calls store new arguments
+    into argument slots and jump to function body, turning recursion into a
+    loop. Calls to other functions destroy stack frame and jump to callee,
+    which then returns directly to our caller. This is only possible when
+    neither function has stack arguments, as callee removes them on return.
+*/
+
+static bool is_tail_call(const ast_node* node, compilation_state* state)
+{
+    const ast_node* call = node->right;
+    if (!call || call->type != NODE_CALL || state->frameless)
+        return false;
+
+    const function* func = func_array_find_func(&state->functions,
+                                                call->value.name);
+    if (!func || !func->node)       // Standard library function
+        return false;
+
+    if (strcmp(call->value.name, state->func_name) == 0)
+        return true;
+
+    return state->stack_arg_cnt == 0 && func->arg_cnt <= call_arg_reg_cnt;
+}
+
+static bool compile_tail_call(const ast_node* node, compilation_state* state)
+{
+    if (state->block_depth == 1)
+        state->has_return = true;
+
+    const ast_node* call = node->right;
+    const function* func = func_array_find_func(&state->functions,
+                                                call->value.name);
+
+    size_t pushed_regs = 0;
+    STEP(compile_call_args(call, func, state, &pushed_regs));
+
+    if (strcmp(call->value.name, state->func_name) != 0)
+    {
+        // mov rsp, rbp
+        state_add_ir_node(state, ir_node_new_binary(IR_MOV,
+                                        ir_operand_reg(IR_REG_RSP),
+                                        ir_operand_reg(IR_REG_RBP)));
+        state_add_ir_node(state, ir_node_new_pop_reg(IR_REG_RBP));
+        compile_restore_regs(state);
+        state_add_ir_node(state, ir_node_new_jmp(func->ir_list_head));
+        return true;
+    }
+
+    for (size_t i = 0; i < state->stack_arg_cnt; ++i)
+    {
+        // pop [rbp+16+8*(saved+i)], last argument is on top
+        ir_node* pop = ir_node_new_empty();
+        pop->is_valid = true;
+        pop->operation = IR_POP;
+        pop->operand1 = {
+            .flags = IR_OPERAND_MEM | IR_OPERAND_REG | IR_OPERAND_IMM,
+            .reg = IR_REG_RBP,
+            .immediate = 16 + 8 * (long) (state->var_regs.saved_cnt + i)
+        };
+        state_add_ir_node(state, pop);
+    }
+
+    if (pushed_regs > 0)
+        state_add_ir_node(state, ir_node_new_binary(IR_ADD,
+                                        ir_operand_reg(IR_REG_RSP),
+                                        ir_operand_imm((long)(8*pushed_regs))));
+    state_add_ir_node(state, ir_node_new_jmp(state->func_body));
+    return true;
+}
+
+static bool compile_expr(const ast_node* node, compilation_state* state,
+                         size_t reg_idx)
+{
+    AST_ASSERT(node != NULL, "Expected expression, got empty node.", NULL);
+
+    const ir_operand dst = ir_operand_reg(expr_reg(state, reg_idx));
+    ir_operand src = {};
+
+    if (node->type == NODE_CONST && state->use_double)
+    {
+        const ir_operand acc = ir_operand_reg(IR_REG_RAX);
+        state_add_ir_node(state, ir_node_new_binary(IR_MOV, acc,
+                                    ir_operand_imm(const_value(node, state))));
+        state_add_ir_node(state, ir_node_new_binary(IR_MOVQ, dst, acc));
+        return true;
+    }
+
+    if (node->type == NODE_CONST)
+    {
+        state_add_ir_node(state, ir_node_new_binary(IR_MOV, dst,
+                                        ir_operand_imm(const_value(node, state))));
+        return true;
+    }
+
+    if (node->type == NODE_VAR)
+    {
+        STEP(get_direct_operand(node, state, &src));
+        compile_move_value(dst.reg, src, state);
+        return true;
+    }
+
+    if (is_intrinsic_call(node, state))
+        return compile_expr_sqrt(node, state, reg_idx);
+
+    if (node->type == NODE_CALL)
+        return compile_expr_call(node, state, reg_idx);
+
+    AST_ASSERT(node->type == NODE_OP,
+               "Expected expression, got node of type %d.", node->type);
+
+    if (is_unary(node->value.op))
+        return compile_expr_unary(node, state, reg_idx);
+    return compile_expr_binary(node, state, reg_idx, true);
+}
+
+static inline ir_cond_flags invert_cond(ir_cond_flags cond)
+{
+    switch (cond)
+    {
+    case IR_COND_GREATER:     return IR_COND_NOT_GREATER;
+    case IR_COND_NOT_GREATER: return IR_COND_GREATER;
+    case IR_COND_LESS:        return IR_COND_NOT_LESS;
+    case IR_COND_NOT_LESS:    return IR_COND_LESS;
+    case IR_COND_EQUAL:       return IR_COND_NOT_EQUAL;
+    case IR_COND_NOT_EQUAL:   return IR_COND_EQUAL;
+    case IR_COND_ABOVE:       return IR_COND_NOT_ABOVE;
+    case IR_COND_NOT_ABOVE:   return IR_COND_ABOVE;
+    case IR_COND_BELOW:       return IR_COND_NOT_BELOW;
+    case IR_COND_NOT_BELOW:   return IR_COND_BELOW;
+
+    case IR_COND_NONE:
+    default:
+        return IR_COND_NONE;
+    }
+}
+
+/**
+ * @brief Check whether expression value is always 0 or 1 and can be
+ * computed into flags alone
+ */
+static bool is_flag_expr(const ast_node* node)
+{
+    if (node->type != NODE_OP)
+        return false;
+    if (node->value.op == OP_NOT)
+        return is_flag_expr(node->right);
+    return is_cmp(node->value.op);
+}
+
+/**
+ * @brief Set flags according to expression value
+ *
+ * @param[out] cond Condition which holds if expression is true
+ */
+static bool compile_cond_flags(const ast_node* node, compilation_state* state,
+                               ir_cond_flags* cond)
+{
+    AST_ASSERT(node != NULL, "Expected expression, got empty node.", NULL);
+
+    if (!is_flag_expr(node) && state->use_double)
+    {
+        STEP(compile_expr(node, state, 0));
+        compile_double_to_flags(expr_reg(state, 0), IR_REG_RAX, state);
+        *cond = IR_COND_NOT_EQUAL;
+        return true;
+    }
+
+    if (!is_flag_expr(node))
+    {
+        const ir_operand dst = ir_operand_reg(expr_reg(state, 0));
+        STEP(compile_expr(node, state, 0));
+        state_add_ir_node(state, ir_node_new_binary(IR_TEST, dst, dst));
+        *cond = IR_COND_NOT_EQUAL;
+        return true;
+    }
+
+    if (node->value.op == OP_NOT)
+    {
+        STEP(compile_cond_flags(node->right, state, cond));
+        *cond = invert_cond(*cond);
+        return true;
+    }
+
+    *cond = get_cmp_cond(node->value.op, state);
+    return compile_expr_binary(node, state, 0, false);
+}
+
+static bool compile_condition(const ast_node* node, compilation_state* state)
+{
+    ir_cond_flags cond = IR_COND_NONE;
+    STEP(compile_cond_flags(node, state, &cond));
+
+    ir_node* jmp_node = ir_node_new_empty();
+    jmp_node->is_valid = true;
+    jmp_node->operation = IR_JMP;
+    jmp_node->flags = invert_cond(cond);    // Jump if condition is false
+    state_add_ir_node(state, jmp_node);
+    ir_stack_push(&state->ir_stack, jmp_node);
+    return true;
+}
@@ -4,14 +4,75 @@
 #include "data_structures/ast/ast.h"
 
 /**
- * @brief Compile AST to MeerkatVM's assembly language
+ * @brief Instruction set level of generated code
+ */
+enum compiler_target
+{
+    TARGET_SSE2,    // Any x86-64 processor
+    TARGET_AVX2     // Haswell and newer, SSE code uses VEX encoding
+};
+
+/**
+ * @brief Largest number of fractional bits in binary fixed-point numbers.
+ * Products and scaled dividends have `2N` fractional bits and must fit in
+ * 64-bit register, so they are exact only below `2^(63 - 2N)` (`2^31` for
+ * `N = 16`).
+ */
+const unsigned FIXED_SHIFT_MAX = 16;
+
+/**
+ * @brief Backend compilation options
+ */
+struct compiler_options
+{
+    /**
+     * @brief `true` if program is allowed to use stdlib functions
+     */
+    bool use_stdlib;
+    /**
+     * @brief `true` if peephole rule statistics should be printed to `stdout`
+     */
+    bool show_peephole_stats;
+    /**
+     * @brief `true` if numbers are scaled by `2^fixed_shift` instead of 1000
+     */
+    bool fixed_pow2;
+    /**
+     * @brief Number of fractional bits in binary fixed-point numbers
+     */
+    unsigned fixed_shift;
+    /**
+     * @brief `true` if numbers are stored as IEEE-754 doubles and computed
+     * with SSE2 instructions (overrides fixed-point options)
+     */
+    bool use_double;
+    /**
+     * @brief `true` if every `print` call writes its output immediately
+     * instead of collecting it in buffer until exit
+     */
+    bool unbuffered_output;
+    /**
+     * @brief Alignment of function entries in bytes (1 for no alignment)
+     */
+    size_t func_align;
+    /**
+     * @brief Alignment of loop headers in bytes (1 for no alignment)
+     */
+    size_t loop_align;
+    /**
+     * @brief Instruction set level of generated code
+     */
+    compiler_target target;
+};
+
+/**
+ * @brief Compile AST to x86-64 ELF executable
  * @param[in] tree Abstract syntax tree
  * @param[inout] output Output file
- * @param[in] use_stdlib `true` if program is allowed to use stdlib functions,
- *              `false` otherwise
+ * @param[in] options Compilation options
  * @return `true` upon successful compilation, `false` otherwise
  */
 bool compiler_tree_to_asm(const abstract_syntax_tree* tree,
-                          FILE* output, bool use_stdlib = false);
+                          FILE* output, const compiler_options* options);
 
 #endif
\ No newline at end of file
@@ -1,14 +1,55 @@
 #include <string.h>
+#include <stdint.h>
+
+#include "data_structures/intermediate_repr/ir_dsl.h"
+#include "ir_cfg.h"
 
 #include "ir_bin_cvt.h"
 
-static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset);
+static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset,
+                            bool use_vex);
+static void ir_assign_addresses(ir_node* ir_list_head, size_t base_offset);
+static bool ir_relax_jumps(ir_node* ir_list_head);
 static void ir_update_jumps(ir_node* ir_list_head);
+static void ir_fill_padding(ir_node* ir_list_head);
 
-void ir_to_binary(ir_node* ir_list_head, size_t base_offset)
+void ir_to_binary(ir_node* ir_list_head, size_t base_offset, bool use_vex)
 {
-    ir_fill_opcodes(ir_list_head, base_offset);
+    ir_fill_opcodes(ir_list_head, base_offset, use_vex);
+
+    /* All jumps start in short form. Promoting a jump may shrink alignment
+     * padding, so distances are not monotonic, but jumps are never demoted
+     * back, so the loop stops after at most one pass per jump. Addresses are
+     * reassigned after every pass, so each remaining short jump is in range */
+    while (ir_relax_jumps(ir_list_head))
+        ir_assign_addresses(ir_list_head, base_offset);
+
     ir_update_jumps(ir_list_head);
+    ir_fill_padding(ir_list_head);
+}
+
+void ir_align_blocks(ir_node* ir_list_head, size_t func_align,
+                     size_t loop_align)
+{
+    ir_cfg cfg = {};
+    ir_cfg_ctor(&cfg, ir_list_head);
+
+    // List head is never moved, so the first block is not aligned
+    for (size_t i = 1; i < cfg.block_cnt; ++i)
+    {
+        const ir_block* block = &cfg.blocks[i];
+        size_t alignment = block->is_entry ? func_align : 1;
+        for (size_t j = 0; j < block->pred_cnt; ++j)
+            if (ir_cfg_dominates(&cfg, i, block->pred[j]) &&
+                    loop_align > alignment)
+                alignment = loop_align;
+
+        if (alignment > 1)
+            ir_list_insert_after(cfg.blocks[i - 1].last,
+                                 ir_node_new_align((long) alignment));
+    }
+
+    ir_cfg_dtor(&cfg);
 }
 
 enum rex_bytes
@@ -34,6 +75,11 @@ enum reg_bytes
 
 enum cond_bytes
 {
+    COND_B  = 0x02,
+    COND_NB = 0x03,
+    COND_BE = 0x06,
+    COND_A  = 0x07,
+
     COND_E  = 0x04,
     COND_NE = 0x05,
     COND_L  = 0x0C,
@@ -50,9 +96,12 @@ enum cond_bytes
 };
 
 static void ir_convert_nop(ir_node* node);
+static void ir_convert_align(ir_node* node, size_t addr);
 
 static void ir_convert_mov (ir_node* node);
 static void ir_convert_cmov(ir_node* node);
+static void ir_convert_movzx(ir_node* node);
+static void ir_convert_setcc(ir_node* node);
 static void ir_convert_push(ir_node* node);
 static void ir_convert_pop (ir_node* node);
 
@@ -61,6 +110,10 @@ static void ir_convert_sub(ir_node* node);
 static void ir_convert_mul(ir_node* node);
 static void ir_convert_div(ir_node* node);
 static void ir_convert_neg(ir_node* node);
+static void ir_convert_mulh(ir_node* node);
+static void ir_convert_lea (ir_node* node);
+
+static void ir_convert_shift(ir_node* node);
 
 static void ir_convert_and(ir_node* node);
 static void ir_convert_or (ir_node* node);
@@ -70,13 +123,17 @@ static void ir_convert_not(ir_node* node);
 static void ir_convert_cmp (ir_node* node);
 static void ir_convert_test(ir_node* node);
 static void ir_convert_jmp (ir_node* node);
+static void ir_convert_jmp_near(ir_node* node);
 
 static void ir_convert_call   (ir_node* node);
 static void ir_convert_ret    (ir_node* node);
 static void ir_convert_syscall(ir_node* node);
 
+static void ir_convert_sse(ir_node* node, bool use_vex);
+
 
-static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset)
+static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset,
+                            bool use_vex)
 {
     ir_node* current = ir_list_head;
     size_t cur_addr = base_offset;
@@ -85,9 +142,12 @@ static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset)
         switch (current->operation)
         {
         case IR_NOP: ir_convert_nop(current); break;
+        case IR_ALIGN: ir_convert_align(current, cur_addr); break;
 
         case IR_MOV:  ir_convert_mov (current); break;
         case IR_CMOV: ir_convert_cmov(current); break;
+        case IR_MOVZX: ir_convert_movzx(current); break;
+        case IR_SETCC: ir_convert_setcc(current); break;
         case IR_PUSH: ir_convert_push(current); break;
         case IR_POP:  ir_convert_pop (current); break;
 
@@ -96,6 +156,11 @@ static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset)
         case IR_MUL: ir_convert_mul(current); break;
         case IR_DIV: ir_convert_div(current); break;
         case IR_NEG: ir_convert_neg(current); break;
+        case IR_MULH: ir_convert_mulh(current); break;
+        case IR_LEA:  ir_convert_lea (current); break;
+
+        case IR_SHL: case IR_SHR: case IR_SAR:
+            ir_convert_shift(current); break;
 
         case IR_AND: ir_convert_and(current); break;
         case IR_OR:  ir_convert_or (current); break;
@@ -110,6 +175,13 @@ static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset)
         case IR_RET:     ir_convert_ret    (current); break;
         case IR_SYSCALL: ir_convert_syscall(current); break;
 
+        case IR_MOVSD:  case IR_MOVQ:
+        case IR_ADDSD:  case IR_SUBSD:
+        case IR_MULSD:  case IR_DIVSD:
+        case IR_SQRTSD: case IR_UCOMISD:
+        case IR_CVTSI2SD: case IR_CVTTSD2SI: case IR_CVTSD2SI:
+            ir_convert_sse(current, use_vex); break;
+
         default:    // Unreachable
             break;
         }
@@ -119,12 +191,61 @@ static void ir_fill_opcodes(ir_node* ir_list_head, size_t base_offset)
     }
 }
 
+static void ir_assign_addresses(ir_node* ir_list_head, size_t base_offset)
+{
+    size_t cur_addr = base_offset;
+    for (ir_node* current = ir_list_head; current; current = current->next)
+    {
+        if (current->operation == IR_ALIGN)     // Padding depends on address
+            ir_convert_align(current, cur_addr);
+        current->addr = cur_addr;
+        cur_addr += current->encoded_length;
+    }
+}
+
+static inline int ir_jump_offset(const ir_node* node)
+{
+    if (!node->jump_target)
+        return 0;
+
+    return - (int) (node->addr + node->encoded_length
+                    - node->jump_target->addr);
+}
+
+static inline bool ir_is_short_jump(const ir_node* node)
+{
+    return node->operation == IR_JMP && node->encoded_length == 2;
+}
+
+static bool ir_relax_jumps(ir_node* ir_list_head)
+{
+    bool changed = false;
+    for (ir_node* current = ir_list_head; current; current = current->next)
+    {
+        if (!ir_is_short_jump(current))
+            continue;
+
+        int offset = ir_jump_offset(current);
+        if (INT8_MIN <= offset && offset <= INT8_MAX)
+            continue;
+
+        ir_convert_jmp_near(current);
+        changed = true;
+    }
+    return changed;
+}
+
 static void ir_update_jumps(ir_node* ir_list_head)
 {
     ir_node* current = ir_list_head;
     while (current)
     {
-        if (current->operation == IR_JMP || current->operation == IR_CALL)
+        if (ir_is_short_jump(current))
+        {
+            current->bytes[1] = (unsigned char) (signed char)
+                                        ir_jump_offset(current);
+        }
+        else if (current->operation == IR_JMP || current->operation == IR_CALL)
         {
             size_t pref_size = 0;
             if (current->operation == IR_JMP && current->flags != IR_COND_NONE)
@@ -132,10 +253,7 @@ static void ir_update_jumps(ir_node* ir_list_head)
             else
                 pref_size = 1;
             
-            int offset = 0;
-            if (current->jump_target)
-                offset = - (int) (current->addr + current->encoded_length
-                            - current->jump_target->addr);
+            int offset = ir_jump_offset(current);
             memcpy(current->bytes + pref_size, &offset, 4);
         }
         current = current->next;
@@ -152,6 +270,10 @@ static inline unsigned char encode_cond(ir_cond_flags cond)
     case IR_COND_NOT_LESS:    return COND_NL;
     case IR_COND_EQUAL:       return COND_E;
     case IR_COND_NOT_EQUAL:   return COND_NE;
+    case IR_COND_ABOVE:       return COND_A;
+    case IR_COND_NOT_ABOVE:   return COND_BE;
+    case IR_COND_BELOW:       return COND_B;
+    case IR_COND_NOT_BELOW:   return COND_NB;
 
     case IR_COND_NONE:
     default:
@@ -172,14 +294,19 @@ static inline unsigned char encode_reg_lo(ir_reg reg)
     case IR_REG_RBP: return REG_EBP;
     case IR_REG_RSI: return REG_ESI;
     case IR_REG_RDI: return REG_EDI;
-    default:    // Unreachable
-        return 0;
+    default:    // R8-R15 and XMM0-XMM15
         break;
     }
+
+    if ((int) reg >= (int) IR_REG_XMM0)
+        return ((int) reg - (int) IR_REG_XMM0) & 07;
+    return ((int) reg - (int) IR_REG_R8) & 07;
 }
 
 static inline unsigned char encode_reg_hi(ir_reg reg)
 {
+    if ((int) reg >= (int) IR_REG_XMM0)
+        return (int) reg >= (int) IR_REG_XMM8;
     return (int) reg >= (int) IR_REG_R8;
 }
 
@@ -222,6 +349,57 @@ static void ir_convert_nop(ir_node* node)
     node->encoded_length = 1;
 }
 
+/* Only length of padding is known before addresses are final */
+static void ir_convert_align(ir_node* node, size_t addr)
+{
+    size_t alignment = (size_t) node->operand1.immediate;
+    node->encoded_length = (alignment - addr % alignment) % alignment;
+}
+
+/* Recommended multi-byte NOPs of length 1 to 9 */
+static const unsigned char NOP_BYTES[][9] = {
+    { 0x90 },
+    { 0x66, 0x90 },
+    { 0x0F, 0x1F, 0x00 },
+    { 0x0F, 0x1F, 0x40, 0x00 },
+    { 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+    { 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+    { 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+    { 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+};
+
+static const size_t NOP_MAX_LENGTH = sizeof(NOP_BYTES[0]);
+
+/* Padding can be longer than single node holds, so it is split between
+ * alignment node and NOP nodes following it */
+static void ir_fill_padding(ir_node* ir_list_head)
+{
+    for (ir_node* current = ir_list_head; current; current = current->next)
+    {
+        if (current->operation != IR_ALIGN)
+            continue;
+
+        size_t total = current->encoded_length;
+        size_t length = total < NOP_MAX_LENGTH ? total : NOP_MAX_LENGTH;
+        if (length > 0)
+            memcpy(current->bytes, NOP_BYTES[length - 1], length);
+        current->encoded_length = length;
+
+        for (size_t filled = length; filled < total; filled += length)
+        {
+            length = total - filled < NOP_MAX_LENGTH ? total - filled
+                                                     : NOP_MAX_LENGTH;
+            ir_node* nop = ir_node_new_empty();
+            nop->is_valid = true;
+            nop->addr = current->addr + current->encoded_length;
+            nop->encoded_length = length;
+            memcpy(nop->bytes, NOP_BYTES[length - 1], length);
+            current = ir_list_insert_after(current, nop);
+        }
+    }
+}
+
 static void ir_convert_mov(ir_node* node)
 {
     node->bytes[0] = REX | REX_W;   // All MOVs are 64-bit
@@ -255,7 +433,9 @@ static void ir_convert_mov(ir_node* node)
             node->bytes[3] = encode_mem_sib(node->operand1);
             int offset = (int) node->operand1.immediate;
             memcpy(node->bytes + 4, &offset, 4);
-            imm_start = 8;
+            memcpy(node->bytes + 8, &node->operand2.immediate, 4);
+            node->encoded_length = 12;
+            return;
         }
         memcpy(node->bytes + imm_start, &node->operand2.immediate, 8);
         node->encoded_length = imm_start + 8;
@@ -322,6 +502,33 @@ static void ir_convert_cmov(ir_node* node)
     return;
 }
 
+static void ir_convert_movzx(ir_node* node)
+{
+    ir_reg dst = node->operand1.reg;
+    ir_reg src = node->operand2.reg;
+
+    // MOVZX r32, r/m8 (upper half of destination is cleared as well)
+    // REX is always present to select SPL-DIL instead of AH-BH
+    node->bytes[0] = REX | encode_reg_pair_rex(src, dst);
+    node->bytes[1] = 0x0F;
+    node->bytes[2] = 0xB6;
+    node->bytes[3] = encode_reg_pair_mod(src, dst);
+    node->encoded_length = 4;
+    return;
+}
+
+static void ir_convert_setcc(ir_node* node)
+{
+    ir_reg dst = node->operand1.reg;
+
+    node->bytes[0] = REX | encode_reg_hi(dst) * REX_B;
+    node->bytes[1] = 0x0F;
+    node->bytes[2] = 0x90 | encode_cond(node->flags);
+    node->bytes[3] = 0xC0 | encode_reg_lo(dst);
+    node->encoded_length = 4;
+    return;
+}
+
 static void ir_convert_push(ir_node* node)
 {
     if (node->operand1.flags == IR_OPERAND_REG) // Push register
@@ -331,6 +538,13 @@ static void ir_convert_push(ir_node* node)
         node->encoded_length = 2;
         return;
     }
+    if (node->operand1.flags == IR_OPERAND_IMM) // Push sign-extended imm32
+    {
+        node->bytes[0] = 0x68;
+        memcpy(node->bytes + 1, &node->operand1.immediate, 4);
+        node->encoded_length = 5;
+        return;
+    }
     node->bytes[0] = REX | encode_mem_rex(node->operand1);
     node->bytes[1] = 0xFF;
     node->bytes[2] = (06 << 3) | encode_mem_mod(node->operand1);
@@ -518,7 +732,7 @@ static void ir_convert_mul(ir_node* node)
 
     if (node->operand2.flags == IR_OPERAND_IMM) // MUL immediate
     {
-        node->bytes[0] |= encode_reg_hi(node->operand1.reg) * REX_B;
+        node->bytes[0] |= encode_reg_hi(node->operand1.reg) * (REX_B | REX_R);
         node->bytes[1] = 0x69;
         unsigned char reg = encode_reg_lo(node->operand1.reg);
         node->bytes[2] |= 0xC0 | (reg << 3) | reg;
@@ -531,14 +745,15 @@ static void ir_convert_mul(ir_node* node)
     ir_operand mem = node->operand2;
 
     node->bytes[0] |= encode_mem_rex(mem) | encode_reg_hi(reg) * REX_R;
-    node->bytes[1]  = 0x6B;
-    node->bytes[2]  = encode_mem_mod(mem) | (encode_reg_lo(reg) << 3);
-    node->bytes[3]  = encode_mem_sib(mem);
+    node->bytes[1]  = 0x0F;
+    node->bytes[2]  = 0xAF;
+    node->bytes[3]  = encode_mem_mod(mem) | (encode_reg_lo(reg) << 3);
+    node->bytes[4]  = encode_mem_sib(mem);
 
     int offset = (int) mem.immediate;
 
-    memcpy(node->bytes+4, &offset, 4);
-    node->encoded_length = 8;
+    memcpy(node->bytes+5, &offset, 4);
+    node->encoded_length = 9;
     return;
 }
 
@@ -563,7 +778,7 @@ static void ir_convert_div(ir_node* node)
     node->bytes[4] |= encode_mem_mod(node->operand1);
     node->bytes[5]  = encode_mem_sib(node->operand1);
     int offset = (int) node->operand1.immediate;
-    memcpy(node->bytes + 4, &offset, 4);
+    memcpy(node->bytes + 6, &offset, 4);
     node->encoded_length = 10;
 }
 
@@ -589,6 +804,72 @@ static void ir_convert_neg(ir_node* node)
     node->encoded_length = 8;
 }
 
+static void ir_convert_mulh(ir_node* node)
+{
+    node->bytes[0] = REX | REX_W;
+    node->bytes[1] = 0xF7;
+    node->bytes[2] = 0x28;          // IMUL r/m64 (RDX:RAX := RAX * r/m64)
+
+    if (node->operand1.flags == IR_OPERAND_REG)
+    {
+        node->bytes[0] |= encode_reg_hi(node->operand1.reg) * REX_B;
+        node->bytes[2] |= 0xC0 | encode_reg_lo(node->operand1.reg);
+        node->encoded_length = 3;
+        return;
+    }
+
+    node->bytes[0] |= encode_mem_rex(node->operand1);
+    node->bytes[2] |= encode_mem_mod(node->operand1);
+    node->bytes[3]  = encode_mem_sib(node->operand1);
+    int offset = (int) node->operand1.immediate;
+    memcpy(node->bytes + 4, &offset, 4);
+    node->encoded_length = 8;
+}
+
+static void ir_convert_lea(ir_node* node)
+{
+    ir_reg dst  = node->operand1.reg;
+    ir_reg base = node->operand2.reg;
+
+    unsigned char scale = 0;
+    switch (node->operand2.immediate)
+    {
+    case 1:  scale = 0x00; break;
+    case 2:  scale = 0x40; break;
+    case 4:  scale = 0x80; break;
+    case 8:  scale = 0xC0; break;
+    default: scale = 0x00; break;  // Unreachable
+    }
+
+    // LEA dst, [base + base*scale]
+    node->bytes[0] = REX | REX_W | encode_reg_hi(dst) * REX_R
+                   | encode_reg_hi(base) * (REX_X | REX_B);
+    node->bytes[1] = 0x8D;
+    node->bytes[2] = 0x04 | encode_reg_lo(dst) << 3;
+    node->bytes[3] = scale | encode_reg_lo(base) << 3 | encode_reg_lo(base);
+    node->encoded_length = 4;
+
+    if (encode_reg_lo(base) == REG_EBP)  // RBP and R13 require displacement
+    {
+        node->bytes[2] |= 0x40;
+        node->bytes[4]  = 0x00;
+        node->encoded_length = 5;
+    }
+}
+
+static void ir_convert_shift(ir_node* node)
+{
+    unsigned char ext = 0x38;                   // SAR
+    if (node->operation == IR_SHL) ext = 0x20;
+    if (node->operation == IR_SHR) ext = 0x28;
+
+    node->bytes[0] = REX | REX_W | encode_reg_hi(node->operand1.reg) * REX_B;
+    node->bytes[1] = 0xC1;
+    node->bytes[2] = 0xC0 | ext | encode_reg_lo(node->operand1.reg);
+    node->bytes[3] = (unsigned char) node->operand2.immediate;
+    node->encoded_length = 4;
+}
+
 static void ir_convert_and(ir_node* node)
 {
     node->bytes[0] = REX | REX_W;
@@ -947,6 +1228,17 @@ static void ir_convert_test(ir_node* node)
 }
 
 static void ir_convert_jmp(ir_node* node)
+{
+    if (node->flags == IR_COND_NONE)
+        node->bytes[0] = 0xEB;  // JMP rel8
+    else
+        node->bytes[0] = 0x70 | encode_cond(node->flags); // Jcc rel8
+
+    node->encoded_length = 2;
+    return;
+}
+
+static void ir_convert_jmp_near(ir_node* node)
 {
     if (node->flags == IR_COND_NONE)
     {
@@ -970,6 +1262,14 @@ static void ir_convert_call(ir_node* node)
 
 static void ir_convert_ret(ir_node* node)
 {
+    if (node->operand1.flags == IR_OPERAND_IMM) // RET imm16
+    {
+        node->bytes[0] = 0xC2;
+        unsigned short pop_size = (unsigned short) node->operand1.immediate;
+        memcpy(node->bytes + 1, &pop_size, 2);
+        node->encoded_length = 3;
+        return;
+    }
     node->bytes[0] = 0xC3;
     node->encoded_length = 1;
     return;
@@ -983,3 +1283,149 @@ static void ir_convert_syscall(ir_node* node)
     return;
 }
 
+/* Encode `prefix [REX] 0F opcode /r` with `reg` in ModRM.reg field and
+ * register or memory `rm` in ModRM.rm field */
+/* ModRM byte and memory operand of SSE instruction, starting at `len` */
+static void encode_sse_operands(ir_node* node, size_t len,
+                                ir_operand reg, ir_operand rm)
+{
+    if (rm.flags == IR_OPERAND_REG)
+    {
+        node->bytes[len++] = 0xC0 | encode_reg_lo(reg.reg) << 3
+                                  | encode_reg_lo(rm.reg);
+        node->encoded_length = len;
+        return;
+    }
+
+    node->bytes[len++] = encode_mem_mod(rm) | encode_reg_lo(reg.reg) << 3;
+    node->bytes[len++] = encode_mem_sib(rm);
+    int offset = (int) rm.immediate;
+    memcpy(node->bytes + len, &offset, 4);
+    node->encoded_length = len + 4;
+}
+
+static void encode_sse(ir_node* node, unsigned char prefix,
+                       unsigned char opcode, bool rex_w,
+                       ir_operand reg, ir_operand rm)
+{
+    size_t len = 0;
+    node->bytes[len++] = prefix;
+
+    unsigned char rex = REX | (rex_w ? REX_W : 0)
+                            | encode_reg_hi(reg.reg) * REX_R;
+    if (rm.flags == IR_OPERAND_REG)
+        rex |= encode_reg_hi(rm.reg) * REX_B;
+    else
+        rex |= encode_mem_rex(rm);
+    if (rex != REX)
+        node->bytes[len++] = rex;
+
+    node->bytes[len++] = 0x0F;
+    node->bytes[len++] = opcode;
+
+    encode_sse_operands(node, len, reg, rm);
+}
+
+/*
+    VEX prefix replaces legacy prefix, REX and 0x0F escape byte, and adds
+    one more source register `vsrc`. Scalar instructions take upper part of
+    result from it, so passing destination keeps legacy SSE behaviour.
+    Two-byte form is used when REX.W, REX.X and REX.B are all clear.
+*/
+static void encode_vex(ir_node* node, unsigned char prefix,
+                       unsigned char opcode, bool rex_w,
+                       ir_operand reg, ir_reg vsrc, ir_operand rm)
+{
+    const unsigned char pp = prefix == 0x66 ? 0x01
+                           : prefix == 0xF3 ? 0x02
+                           : 0x03;  // 0xF2
+    const unsigned char vvvv = vsrc == IR_REG_NONE
+                    ? 0x0F
+                    : (unsigned char) (~(encode_reg_hi(vsrc) << 3
+                                         | encode_reg_lo(vsrc)) & 0x0F);
+    const bool r = encode_reg_hi(reg.reg);
+    const bool b = rm.flags == IR_OPERAND_REG ? encode_reg_hi(rm.reg)
+                                              : encode_mem_rex(rm) != 0;
+
+    size_t len = 0;
+    if (!rex_w && !b)
+    {
+        node->bytes[len++] = 0xC5;
+        node->bytes[len++] = (unsigned char) (!r << 7 | vvvv << 3 | pp);
+    }
+    else
+    {
+        node->bytes[len++] = 0xC4;
+        node->bytes[len++] = (unsigned char) (!r << 7 | 1 << 6 | !b << 5
+                                              | 0x01);  // 0x0F map
+        node->bytes[len++] = (unsigned char) (rex_w << 7 | vvvv << 3 | pp);
+    }
+    node->bytes[len++] = opcode;
+
+    encode_sse_operands(node, len, reg, rm);
+}
+
+static void ir_convert_sse(ir_node* node, bool use_vex)
+{
+    unsigned char prefix = 0xF2;
+    unsigned char opcode = 0;
+    bool          rex_w  = false;
+    ir_operand    reg    = node->operand1;
+    ir_operand    rm     = node->operand2;
+    ir_reg        vsrc   = IR_REG_NONE;  // Second source of VEX form
+
+    switch (node->operation)
+    {
+    case IR_MOVSD:
+        if (reg.flags & IR_OPERAND_MEM)     // MOVSD m64, xmm
+        {
+            opcode = 0x11;
+            reg = node->operand2;
+            rm  = node->operand1;
+        }
+        else                                // MOVSD xmm, xmm/m64
+        {
+            opcode = 0x10;
+            vsrc = rm.flags == IR_OPERAND_REG ? reg.reg : IR_REG_NONE;
+        }
+        break;
+    case IR_MOVQ:
+        prefix = 0x66;
+        rex_w  = true;
+        if (reg.flags == IR_OPERAND_REG && (int) reg.reg >= (int) IR_REG_XMM0)
+            opcode = 0x6E;                  // MOVQ xmm, r/m64
+        else
+        {
+            opcode = 0x7E;                  // MOVQ r/m64, xmm
+            reg = node->operand2;
+            rm  = node->operand1;
+        }
+        break;
+
+    case IR_ADDSD:  opcode = 0x58; vsrc = reg.reg; break;
+    case IR_SUBSD:  opcode = 0x5C; vsrc = reg.reg; break;
+    case IR_MULSD:  opcode = 0x59; vsrc = reg.reg; break;
+    case IR_DIVSD:  opcode = 0x5E; vsrc = reg.reg; break;
+    case IR_SQRTSD: opcode = 0x51; vsrc = reg.reg; break;
+
+    case IR_UCOMISD:   prefix = 0x66; opcode = 0x2E; break;
+    case IR_CVTSI2SD:  opcode = 0x2A; rex_w = true; vsrc = reg.reg; break;
+    case IR_CVTTSD2SI: opcode = 0x2C; rex_w = true; break;
+    case IR_CVTSD2SI:  opcode = 0x2D; rex_w = true; break;
+
+    case IR_NOP:  case IR_ALIGN:
+    case IR_MOV:  case IR_CMOV: case IR_MOVZX: case IR_SETCC:
+    case IR_PUSH: case IR_POP:  case IR_ADD:  case IR_SUB:   case IR_MUL:
+    case IR_DIV:  case IR_NEG:  case IR_MULH: case IR_LEA:   case IR_SHL:
+    case IR_SHR:  case IR_SAR:  case IR_AND:  case IR_OR:    case IR_XOR:
+    case IR_NOT:  case IR_CMP:  case IR_TEST: case IR_JMP:   case IR_CALL:
+    case IR_RET:  case IR_SYSCALL:
+    default:    // Unreachable
+        return;
+    }
+
+    if (use_vex)
+        encode_vex(node, prefix, opcode, rex_w, reg, vsrc, rm);
+    else
+        encode_sse(node, prefix, opcode, rex_w, reg, rm);
+}
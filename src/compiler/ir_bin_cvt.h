@@ -18,8 +18,25 @@
  * @brief Fills IR list with compiled operation bytes
  *
  * @param[inout] ir_list_head	Head of IR list
+ * @param[in]    base_offset    Address of first IR node
+ * @param[in]    use_vex        Encode SSE instructions with VEX prefix
+ *                              (requires AVX)
  *
  */
-void ir_to_binary(ir_node* ir_list_head, size_t base_offset);
+void ir_to_binary(ir_node* ir_list_head, size_t base_offset, bool use_vex);
+
+/**
+ * @brief Put alignment directives before function entries and loop
+ * headers. Loop header is a block, which dominates one of its
+ * predecessors. Directives are encoded as multi-byte NOPs, so they are
+ * executed only when control falls through into aligned block.
+ *
+ * @param[inout] ir_list_head   Head of IR list
+ * @param[in]    func_align     Alignment of function entries (1 to disable)
+ * @param[in]    loop_align     Alignment of loop headers (1 to disable)
+ *
+ */
+void ir_align_blocks(ir_node* ir_list_head, size_t func_align,
+                     size_t loop_align);
 
 #endif /* ir_bin_cvt.h */
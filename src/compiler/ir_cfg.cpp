@@ -0,0 +1,290 @@
+#include "ir_cfg.h"
+
+static size_t number_nodes(ir_node* ir_list_head, ir_node*** nodes);
+static void find_leaders(ir_node** nodes, size_t node_cnt,
+                         bool* is_leader, bool* is_entry);
+static void connect_blocks(ir_cfg* cfg, ir_node** nodes, size_t node_cnt,
+                           const size_t* block_of);
+static void fill_predecessors(ir_cfg* cfg);
+static void find_dominators(ir_cfg* cfg);
+
+void ir_cfg_ctor(ir_cfg* cfg, ir_node* ir_list_head)
+{
+    ir_node** nodes = NULL;
+    size_t node_cnt = number_nodes(ir_list_head, &nodes);
+
+    bool* is_leader = (bool*) calloc(node_cnt, sizeof(*is_leader));
+    bool* is_entry  = (bool*) calloc(node_cnt, sizeof(*is_entry));
+    find_leaders(nodes, node_cnt, is_leader, is_entry);
+
+    size_t block_cnt = 0;
+    for (size_t i = 0; i < node_cnt; ++i)
+        if (is_leader[i]) ++block_cnt;
+
+    cfg->blocks    = (ir_block*) calloc(block_cnt, sizeof(*cfg->blocks));
+    cfg->block_cnt = block_cnt;
+
+    size_t* block_of = (size_t*) calloc(node_cnt, sizeof(*block_of));
+    size_t block = 0;
+    for (size_t i = 0; i < node_cnt; ++i)
+    {
+        if (is_leader[i])
+        {
+            block = i == 0 ? 0 : block + 1;
+            cfg->blocks[block].first    = nodes[i];
+            cfg->blocks[block].is_entry = is_entry[i];
+        }
+        cfg->blocks[block].last = nodes[i];
+        block_of[i] = block;
+    }
+
+    connect_blocks(cfg, nodes, node_cnt, block_of);
+    fill_predecessors(cfg);
+    find_dominators(cfg);
+
+    free(block_of);
+    free(is_entry);
+    free(is_leader);
+    free(nodes);
+}
+
+void ir_cfg_dtor(ir_cfg* cfg)
+{
+    free(cfg->pred_storage);
+    free(cfg->blocks);
+    cfg->pred_storage = NULL;
+    cfg->blocks       = NULL;
+    cfg->block_cnt    = 0;
+}
+
+bool ir_cfg_dominates(const ir_cfg* cfg, size_t dominator, size_t block)
+{
+    while (block != IR_CFG_NO_BLOCK)
+    {
+        if (block == dominator)
+            return true;
+        block = cfg->blocks[block].idom;
+    }
+    return false;
+}
+
+static size_t number_nodes(ir_node* ir_list_head, ir_node*** nodes)
+{
+    size_t node_cnt = 0;
+    for (ir_node* current = ir_list_head; current; current = current->next)
+        current->node_id = node_cnt++;
+
+    *nodes = (ir_node**) calloc(node_cnt, sizeof(**nodes));
+    for (ir_node* current = ir_list_head; current; current = current->next)
+        (*nodes)[current->node_id] = current;
+
+    return node_cnt;
+}
+
+/* Jump targets outside of list (e.g. standard library) are not numbered */
+static inline bool is_in_list(ir_node** nodes, size_t node_cnt,
+                              const ir_node* node)
+{
+    return node && node->node_id < node_cnt && nodes[node->node_id] == node;
+}
+
+static inline bool is_block_end(const ir_node* node)
+{
+    return node->is_valid && (node->operation == IR_JMP
+                           || node->operation == IR_RET);
+}
+
+static void find_leaders(ir_node** nodes, size_t node_cnt,
+                         bool* is_leader, bool* is_entry)
+{
+    if (node_cnt == 0)
+        return;
+
+    is_leader[0] = is_entry[0] = true;
+    for (size_t i = 0; i < node_cnt; ++i)
+    {
+        const ir_node* node = nodes[i];
+        if (!node->is_valid)
+            continue;
+
+        if (is_in_list(nodes, node_cnt, node->jump_target))
+        {
+            size_t target = node->jump_target->node_id;
+            is_leader[target] = true;
+            if (node->operation == IR_CALL)
+                is_entry[target] = true;
+        }
+
+        if (is_block_end(node) && i + 1 < node_cnt)
+            is_leader[i + 1] = true;
+    }
+}
+
+static void connect_blocks(ir_cfg* cfg, ir_node** nodes, size_t node_cnt,
+                           const size_t* block_of)
+{
+    for (size_t i = 0; i < cfg->block_cnt; ++i)
+    {
+        ir_block* block = &cfg->blocks[i];
+        const ir_node* last = block->last;
+
+        bool falls_through = true;
+        if (last->is_valid && last->operation == IR_RET)
+            falls_through = false;
+        else if (last->is_valid && last->operation == IR_JMP)
+        {
+            falls_through = last->flags != IR_COND_NONE;
+            if (is_in_list(nodes, node_cnt, last->jump_target))
+                block->succ[block->succ_cnt++] =
+                                    block_of[last->jump_target->node_id];
+            else
+                block->has_exit = true;
+        }
+
+        if (!falls_through)
+            continue;
+
+        if (i + 1 < cfg->block_cnt)
+            block->succ[block->succ_cnt++] = i + 1;
+        else
+            block->has_exit = true;
+    }
+}
+
+static void fill_predecessors(ir_cfg* cfg)
+{
+    size_t edge_cnt = 0;
+    for (size_t i = 0; i < cfg->block_cnt; ++i)
+    {
+        edge_cnt += cfg->blocks[i].succ_cnt;
+        for (size_t j = 0; j < cfg->blocks[i].succ_cnt; ++j)
+            cfg->blocks[cfg->blocks[i].succ[j]].pred_cnt++;
+    }
+
+    cfg->pred_storage = (size_t*) calloc(edge_cnt, sizeof(*cfg->pred_storage));
+
+    size_t offset = 0;
+    for (size_t i = 0; i < cfg->block_cnt; ++i)
+    {
+        cfg->blocks[i].pred = cfg->pred_storage + offset;
+        offset += cfg->blocks[i].pred_cnt;
+        cfg->blocks[i].pred_cnt = 0;
+    }
+
+    for (size_t i = 0; i < cfg->block_cnt; ++i)
+        for (size_t j = 0; j < cfg->blocks[i].succ_cnt; ++j)
+        {
+            ir_block* succ = &cfg->blocks[cfg->blocks[i].succ[j]];
+            succ->pred[succ->pred_cnt++] = i;
+        }
+}
+
+/* Number blocks reachable from entries in postorder */
+static size_t number_postorder(const ir_cfg* cfg, size_t* order,
+                               size_t* postorder)
+{
+    size_t* stack     = (size_t*) calloc(cfg->block_cnt, sizeof(*stack));
+    size_t* next_succ = (size_t*) calloc(cfg->block_cnt, sizeof(*next_succ));
+    bool*   visited   = (bool*)   calloc(cfg->block_cnt, sizeof(*visited));
+
+    size_t cnt = 0;
+    for (size_t entry = 0; entry < cfg->block_cnt; ++entry)
+    {
+        if (!cfg->blocks[entry].is_entry || visited[entry])
+            continue;
+
+        size_t depth = 0;
+        stack[depth++] = entry;
+        visited[entry] = true;
+        while (depth > 0)
+        {
+            size_t top = stack[depth - 1];
+            const ir_block* block = &cfg->blocks[top];
+            if (next_succ[top] < block->succ_cnt)
+            {
+                size_t succ = block->succ[next_succ[top]++];
+                if (!visited[succ])
+                {
+                    visited[succ] = true;
+                    stack[depth++] = succ;
+                }
+                continue;
+            }
+            postorder[top] = cnt;
+            order[cnt++] = top;
+            --depth;
+        }
+    }
+
+    free(visited);
+    free(next_succ);
+    free(stack);
+    return cnt;
+}
+
+/* Cooper, Harvey and Kennedy iterative algorithm. Entry blocks are treated
+ * as children of virtual root with index `block_cnt` */
+static void find_dominators(ir_cfg* cfg)
+{
+    const size_t root = cfg->block_cnt;
+    size_t* order     = (size_t*) calloc(root + 1, sizeof(*order));
+    size_t* postorder = (size_t*) calloc(root + 1, sizeof(*postorder));
+    size_t* idom      = (size_t*) calloc(root + 1, sizeof(*idom));
+
+    for (size_t i = 0; i <= root; ++i)
+        idom[i] = IR_CFG_NO_BLOCK;
+
+    size_t reachable = number_postorder(cfg, order, postorder);
+    for (size_t i = 0; i < reachable; ++i)
+        cfg->blocks[order[i]].is_reachable = true;
+
+    postorder[root] = reachable;
+    idom[root] = root;
+    for (size_t i = 0; i < root; ++i)
+        if (cfg->blocks[i].is_entry) idom[i] = root;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = reachable; i-- > 0;)
+        {
+            size_t block = order[i];
+            if (cfg->blocks[block].is_entry)
+                continue;
+
+            size_t new_idom = IR_CFG_NO_BLOCK;
+            for (size_t j = 0; j < cfg->blocks[block].pred_cnt; ++j)
+            {
+                size_t pred = cfg->blocks[block].pred[j];
+                if (idom[pred] == IR_CFG_NO_BLOCK)
+                    continue;       // Not processed yet
+                if (new_idom == IR_CFG_NO_BLOCK)
+                {
+                    new_idom = pred;
+                    continue;
+                }
+                size_t a = pred, b = new_idom;
+                while (a != b)
+                {
+                    while (postorder[a] < postorder[b]) a = idom[a];
+                    while (postorder[b] < postorder[a]) b = idom[b];
+                }
+                new_idom = a;
+            }
+
+            if (new_idom != idom[block])
+            {
+                idom[block] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < root; ++i)
+        cfg->blocks[i].idom = idom[i] == root ? IR_CFG_NO_BLOCK : idom[i];
+
+    free(idom);
+    free(postorder);
+    free(order);
+}
@@ -0,0 +1,94 @@
+/**
+ * @file ir_cfg.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief Control flow graph of backend IR
+ *
+ * Graph is built directly over `ir_node` list and is not converted to SSA
+ * form: IR only names physical registers and values are kept in stack slots
+ * between statements, so there are no virtual registers to rename.
+ *
+ * @version 0.1
+ * @date 2023-05-30
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __COMPILER_IR_CFG_H
+#define __COMPILER_IR_CFG_H
+
+#include <stddef.h>
+
+#include "data_structures/intermediate_repr/ir.h"
+
+/**
+ * @brief Index used instead of missing block
+ */
+const size_t IR_CFG_NO_BLOCK = (size_t) -1;
+
+/**
+ * @brief Straight-line sequence of IR nodes. Control enters block only at
+ * its first node and leaves it only after its last node.
+ */
+struct ir_block
+{
+    ir_node*    first;          // First node of block
+    ir_node*    last;           // Last node of block
+
+    size_t      succ[2];        // Indices of successor blocks
+    size_t      succ_cnt;       // Number of successor blocks
+    size_t*     pred;           // Indices of predecessor blocks
+    size_t      pred_cnt;       // Number of predecessor blocks
+
+    size_t      idom;           // Immediate dominator, `IR_CFG_NO_BLOCK`
+                                // if block is dominated only by entries
+    bool        is_entry;       // Block starts program or function
+    bool        is_reachable;   // Block can be reached from any entry
+    bool        has_exit;       // Control can leave IR list after block
+};
+
+/**
+ * @brief Control flow graph. Blocks are stored in the same order as IR
+ * nodes, so that `blocks[i + 1].first` follows `blocks[i].last`. Calls
+ * are not considered edges: each called node starts a separate entry
+ * block.
+ */
+struct ir_cfg
+{
+    ir_block*   blocks;
+    size_t      block_cnt;
+
+    size_t*     pred_storage;   // Storage for all predecessor lists
+};
+
+/**
+ * @brief Split IR list into basic blocks, connect them, find blocks
+ * reachable from entries and immediate dominators of each block. Nodes in
+ * list are renumbered.
+ *
+ * @param[out] cfg          Constructed graph
+ * @param[in]  ir_list_head Head of IR list
+ *
+ */
+void ir_cfg_ctor(ir_cfg* cfg, ir_node* ir_list_head);
+
+/**
+ * @brief Destroy control flow graph. IR list is not changed.
+ *
+ * @param[inout] cfg    Destroyed graph
+ *
+ */
+void ir_cfg_dtor(ir_cfg* cfg);
+
+/**
+ * @brief Check whether every path from entry block to `block` passes
+ * through `dominator`. Each block dominates itself.
+ *
+ * @param[in] cfg       Control flow graph
+ * @param[in] dominator Index of dominating block
+ * @param[in] block     Index of dominated block
+ *
+ * @return `true` if `dominator` dominates `block`, `false` otherwise
+ */
+bool ir_cfg_dominates(const ir_cfg* cfg, size_t dominator, size_t block);
+
+#endif /* ir_cfg.h */
@@ -0,0 +1,687 @@
+#include <stdint.h>
+
+#include "ir_peephole.h"
+#include "ir_cfg.h"
+
+/* Maximum number of nodes inspected when looking for the next use of value */
+static const size_t PEEPHOLE_WINDOW = 16;
+
+enum value_usage
+{
+    VALUE_UNUSED,   // Node does not touch value
+    VALUE_READ,     // Node depends on value
+    VALUE_KILLED,   // Node overwrites value without reading it
+    VALUE_UNKNOWN   // Control flow leaves the window
+};
+
+static bool apply_rules(ir_node* prev, ir_node* node, peephole_stats* stats);
+static bool apply_global_rules(ir_node* ir_list_head, peephole_stats* stats);
+static void remove_invalid_nodes(ir_node* ir_list_head, peephole_stats* stats);
+
+void ir_peephole_optimize(ir_node* ir_list_head, peephole_stats* stats)
+{
+    peephole_stats dummy = {};
+    if (!stats) stats = &dummy;
+
+    do
+    {
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            ir_node* prev = ir_list_head;
+            while (prev->next)
+            {
+                if (apply_rules(prev, prev->next, stats))
+                    changed = true; // Re-examine window at the same position
+                else
+                    prev = prev->next;
+            }
+        }
+    } while (apply_global_rules(ir_list_head, stats));
+
+    remove_invalid_nodes(ir_list_head, stats);
+}
+
+void peephole_stats_print(const peephole_stats* stats, FILE* output)
+{
+    static const char* const rule_names[PEEPHOLE_RULE_COUNT] = {
+        "push r; pop r",
+        "push a; pop b     -> mov b, a",
+        "mov r, x; push r  -> push x",
+        "mov r, x; op y, r -> op y, x",
+        "dead register write",
+        "dead register write (global)",
+        "unreachable code",
+        "jump to next instruction",
+        "empty node"
+    };
+
+    fputs("Peephole rule hits:\n", output);
+    for (size_t i = 0; i < PEEPHOLE_RULE_COUNT; ++i)
+        fprintf(output, "  %-32s %zu\n", rule_names[i], stats->hits[i]);
+}
+
+static inline bool is_reg(const ir_operand* operand)
+{
+    return operand->flags == IR_OPERAND_REG;
+}
+
+static inline bool is_mem(const ir_operand* operand)
+{
+    return operand->flags & IR_OPERAND_MEM;
+}
+
+static inline bool is_imm(const ir_operand* operand)
+{
+    return operand->flags == IR_OPERAND_IMM;
+}
+
+static inline bool is_imm32(const ir_operand* operand)
+{
+    return is_imm(operand) && INT32_MIN <= operand->immediate
+                           && operand->immediate <= INT32_MAX;
+}
+
+/* Operand is the register itself or memory addressed by it */
+static inline bool uses_reg(const ir_operand* operand, ir_reg reg)
+{
+    return (operand->flags & IR_OPERAND_REG) && operand->reg == reg;
+}
+
+/* Register keeps its value across calls: RBP and registers of variables */
+static inline bool is_preserved_reg(ir_reg reg)
+{
+    return reg == IR_REG_RBP || reg == IR_REG_RBX
+        || reg == IR_REG_R12 || reg == IR_REG_R13;
+}
+
+static inline bool is_same_reg(const ir_operand* a, const ir_operand* b)
+{
+    return is_reg(a) && is_reg(b) && a->reg == b->reg;
+}
+
+static inline void remove_after(ir_node* prev)
+{
+    ir_node* removed = prev->next;
+    prev->next = removed->next;
+    ir_node_free(removed);
+}
+
+static value_usage get_reg_usage(const ir_node* node, ir_reg reg)
+{
+    if (!node->is_valid)
+        return VALUE_UNUSED;    // Labels do not change values
+
+    const ir_operand* dst = &node->operand1;
+    const ir_operand* src = &node->operand2;
+
+    switch (node->operation)
+    {
+    case IR_NOP: case IR_ALIGN:
+        return VALUE_UNUSED;
+
+    case IR_MOV:
+    case IR_MOVSD: case IR_MOVQ:
+    case IR_CVTSI2SD: case IR_CVTTSD2SI: case IR_CVTSD2SI: case IR_SQRTSD:
+        if (uses_reg(src, reg))
+            return VALUE_READ;
+        if (is_reg(dst) && dst->reg == reg)
+            return VALUE_KILLED;
+        return uses_reg(dst, reg) ? VALUE_READ : VALUE_UNUSED;
+
+    case IR_MOVZX:
+        if (uses_reg(src, reg))
+            return VALUE_READ;
+        return uses_reg(dst, reg) ? VALUE_KILLED : VALUE_UNUSED;
+
+    case IR_SETCC:  // Only lower byte is written
+        return uses_reg(dst, reg) ? VALUE_READ : VALUE_UNUSED;
+
+    case IR_POP:
+        if (reg == IR_REG_RSP)
+            return VALUE_READ;
+        if (is_reg(dst) && dst->reg == reg)
+            return VALUE_KILLED;
+        return uses_reg(dst, reg) ? VALUE_READ : VALUE_UNUSED;
+
+    case IR_PUSH:
+        return reg == IR_REG_RSP || uses_reg(dst, reg)
+                    ? VALUE_READ : VALUE_UNUSED;
+
+    case IR_XOR:
+        if (is_same_reg(dst, src) && dst->reg == reg)
+            return VALUE_KILLED;    // Zeroing idiom
+        /* fallthrough */
+    case IR_CMOV:
+    case IR_ADD: case IR_SUB: case IR_MUL:
+    case IR_AND: case IR_OR:
+    case IR_NEG: case IR_NOT:
+    case IR_SHL: case IR_SHR: case IR_SAR:
+    case IR_CMP: case IR_TEST:
+    case IR_ADDSD: case IR_SUBSD: case IR_MULSD: case IR_DIVSD:
+    case IR_UCOMISD:
+        return uses_reg(dst, reg) || uses_reg(src, reg)
+                    ? VALUE_READ : VALUE_UNUSED;
+
+    case IR_LEA:
+        if (uses_reg(src, reg))
+            return VALUE_READ;
+        return uses_reg(dst, reg) ? VALUE_KILLED : VALUE_UNUSED;
+
+    case IR_MULH:
+        if (reg == IR_REG_RAX || uses_reg(dst, reg))
+            return VALUE_READ;
+        return reg == IR_REG_RDX ? VALUE_KILLED : VALUE_UNUSED;
+
+    case IR_DIV:
+        if (reg == IR_REG_RAX || uses_reg(dst, reg))
+            return VALUE_READ;
+        return reg == IR_REG_RDX ? VALUE_KILLED : VALUE_UNUSED;
+
+    case IR_RET:
+        if (reg == IR_REG_RAX || reg == IR_REG_RSP || is_preserved_reg(reg))
+            return VALUE_READ;
+        return VALUE_KILLED;        // Caller does not expect other registers
+
+    case IR_CALL:                   // Arguments are passed in RDI, RSI, R14, R15
+        if (reg == IR_REG_RSP || reg == IR_REG_RBP ||
+            reg == IR_REG_RDI || reg == IR_REG_RSI ||
+            reg == IR_REG_R14 || reg == IR_REG_R15)
+            return VALUE_READ;
+        if (is_preserved_reg(reg))
+            return VALUE_UNUSED;
+        return VALUE_KILLED;        // Callee does not preserve other registers
+
+    case IR_JMP:
+    case IR_SYSCALL:
+    default:
+        return VALUE_UNKNOWN;
+    }
+}
+
+static value_usage get_flags_usage(const ir_node* node)
+{
+    if (!node->is_valid)
+        return VALUE_UNUSED;
+
+    switch (node->operation)
+    {
+    case IR_CMOV: case IR_SETCC:
+        return VALUE_READ;
+    case IR_JMP:
+        return node->flags == IR_COND_NONE ? VALUE_UNKNOWN : VALUE_READ;
+
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_NEG:
+    case IR_MULH: case IR_SHL: case IR_SHR: case IR_SAR:
+    case IR_AND: case IR_OR:  case IR_XOR:
+    case IR_CMP: case IR_TEST: case IR_UCOMISD:
+    case IR_CALL: case IR_RET:
+        return VALUE_KILLED;
+
+    case IR_NOP: case IR_ALIGN: case IR_MOV: case IR_MOVZX: case IR_LEA:
+    case IR_PUSH: case IR_POP: case IR_NOT:
+    case IR_MOVSD: case IR_MOVQ: case IR_ADDSD: case IR_SUBSD:
+    case IR_MULSD: case IR_DIVSD: case IR_SQRTSD:
+    case IR_CVTSI2SD: case IR_CVTTSD2SI: case IR_CVTSD2SI:
+        return VALUE_UNUSED;
+
+    case IR_SYSCALL:
+    default:
+        return VALUE_UNKNOWN;
+    }
+}
+
+static bool is_reg_dead_after(const ir_node* node, ir_reg reg)
+{
+    if (reg == IR_REG_RSP || reg == IR_REG_RBP)
+        return false;
+
+    const ir_node* current = node->next;
+    for (size_t i = 0; current && i < PEEPHOLE_WINDOW; ++i)
+    {
+        switch (get_reg_usage(current, reg))
+        {
+        case VALUE_UNUSED:  break;
+        case VALUE_KILLED:  return true;
+        case VALUE_READ:
+        case VALUE_UNKNOWN:
+        default:
+            return false;
+        }
+        current = current->next;
+    }
+    return false;
+}
+
+static bool are_flags_dead_after(const ir_node* node)
+{
+    const ir_node* current = node->next;
+    for (size_t i = 0; current && i < PEEPHOLE_WINDOW; ++i)
+    {
+        switch (get_flags_usage(current))
+        {
+        case VALUE_UNUSED:  break;
+        case VALUE_KILLED:  return true;
+        case VALUE_READ:
+        case VALUE_UNKNOWN:
+        default:
+            return false;
+        }
+        current = current->next;
+    }
+    return false;
+}
+
+/* Set of registers. Bit 0 (`IR_REG_NONE`) stands for flags register */
+typedef uint64_t reg_set;
+
+static const reg_set FLAGS_BIT  = 1;
+static const reg_set ALL_REGS   = ((reg_set) 1 << (IR_REG_XMM15 + 1)) - 1;
+static const reg_set STACK_REGS = ((reg_set) 1 << IR_REG_RSP)
+                                | ((reg_set) 1 << IR_REG_RBP);
+
+/* Same as `get_reg_usage()`, but jumps are represented by CFG edges */
+static value_usage get_global_reg_usage(const ir_node* node, ir_reg reg)
+{
+    if (node->is_valid && node->operation == IR_JMP)
+        return VALUE_UNUSED;
+    if (node->is_valid && node->operation == IR_SYSCALL)
+        return VALUE_READ;
+    return get_reg_usage(node, reg);
+}
+
+static value_usage get_global_flags_usage(const ir_node* node)
+{
+    if (node->is_valid && node->operation == IR_JMP)
+        return node->flags == IR_COND_NONE ? VALUE_UNUSED : VALUE_READ;
+    if (node->is_valid && node->operation == IR_SYSCALL)
+        return VALUE_READ;
+    return get_flags_usage(node);
+}
+
+static void get_node_effect(const ir_node* node, reg_set* read, reg_set* kill)
+{
+    *read = *kill = 0;
+    for (unsigned reg = IR_REG_RAX; reg <= IR_REG_XMM15; ++reg)
+    {
+        value_usage usage = get_global_reg_usage(node, (ir_reg) reg);
+        if (usage == VALUE_READ || usage == VALUE_UNKNOWN)
+            *read |= (reg_set) 1 << reg;
+        else if (usage == VALUE_KILLED)
+            *kill |= (reg_set) 1 << reg;
+    }
+
+    value_usage usage = get_global_flags_usage(node);
+    if (usage == VALUE_READ || usage == VALUE_UNKNOWN)
+        *read |= FLAGS_BIT;
+    else if (usage == VALUE_KILLED)
+        *kill |= FLAGS_BIT;
+}
+
+/* Check whether `regs` are overwritten before being read after `node` */
+static bool are_dead_after(const ir_node* node, const ir_node* block_end,
+                           reg_set regs, reg_set live_out)
+{
+    for (const ir_node* current = node->next; current != block_end;
+                                              current = current->next)
+    {
+        reg_set read = 0, kill = 0;
+        get_node_effect(current, &read, &kill);
+        if (regs & read)
+            return false;
+        regs &= ~kill;
+        if (!regs)
+            return true;
+    }
+    return !(regs & live_out);
+}
+
+/* Liveness at the end of basic block, which replaces fixed-size window */
+struct block_liveness
+{
+    const ir_node*  end;        // Node following the block
+    reg_set         live_out;   // Registers live after the block
+};
+
+static bool is_dead_after(const ir_node* node, reg_set regs,
+                          const block_liveness* live)
+{
+    if (regs & STACK_REGS)
+        return false;
+    if (live)
+        return are_dead_after(node, live->end, regs, live->live_out);
+
+    if ((regs & FLAGS_BIT) && !are_flags_dead_after(node))
+        return false;
+    for (unsigned reg = IR_REG_RAX; reg <= IR_REG_XMM15; ++reg)
+        if ((regs & ((reg_set) 1 << reg))
+                && !is_reg_dead_after(node, (ir_reg) reg))
+            return false;
+    return true;
+}
+
+/* Check whether `mov dst, src` can be encoded */
+static inline bool is_valid_move(const ir_operand* dst, const ir_operand* src)
+{
+    if (is_mem(dst) && is_mem(src))
+        return false;
+    if (is_mem(dst) && is_imm(src))
+        return is_imm32(src);
+    return !is_imm(dst);
+}
+
+/* Check whether `op reg, src` accepts `src` instead of register */
+static inline bool accepts_operand(ir_op operation, const ir_operand* src)
+{
+    switch (operation)
+    {
+    case IR_ADD: case IR_SUB: case IR_MUL:
+    case IR_AND: case IR_OR:  case IR_XOR:
+    case IR_CMP:
+        return is_mem(src) || is_imm32(src) || is_reg(src);
+    case IR_MOV:
+        return true;
+
+    case IR_NOP:  case IR_ALIGN: case IR_CMOV: case IR_PUSH: case IR_POP:
+    case IR_MOVZX: case IR_SETCC: case IR_MULH: case IR_LEA:
+    case IR_SHL:   case IR_SHR:   case IR_SAR:
+    case IR_MOVSD: case IR_MOVQ:  case IR_ADDSD: case IR_SUBSD:
+    case IR_MULSD: case IR_DIVSD: case IR_SQRTSD: case IR_UCOMISD:
+    case IR_CVTSI2SD: case IR_CVTTSD2SI: case IR_CVTSD2SI:
+    case IR_DIV:  case IR_NEG:  case IR_NOT:  case IR_TEST:
+    case IR_JMP:  case IR_CALL: case IR_RET:  case IR_SYSCALL:
+    default:
+        return false;
+    }
+}
+
+static bool rule_push_pop(ir_node* prev, ir_node* node, peephole_stats* stats)
+{
+    ir_node* next = node->next;
+    if (node->operation != IR_PUSH || next->operation != IR_POP)
+        return false;
+
+    const ir_operand* src = &node->operand1;
+    const ir_operand* dst = &next->operand1;
+    if (uses_reg(src, IR_REG_RSP) || uses_reg(dst, IR_REG_RSP))
+        return false;
+
+    if (is_same_reg(src, dst))
+    {
+        remove_after(node);
+        remove_after(prev);
+        stats->hits[PEEPHOLE_PUSH_POP_SAME]++;
+        return true;
+    }
+
+    if (!is_valid_move(dst, src))
+        return false;
+
+    node->operation = IR_MOV;
+    node->operand2  = *src;
+    node->operand1  = *dst;
+    remove_after(node);
+    stats->hits[PEEPHOLE_PUSH_POP_MOVE]++;
+    return true;
+}
+
+static bool rule_push_direct(ir_node* prev, ir_node* node, peephole_stats* stats)
+{
+    ir_node* next = node->next;
+    if (node->operation != IR_MOV || next->operation != IR_PUSH)
+        return false;
+    if (!is_reg(&node->operand1) || !is_same_reg(&node->operand1,
+                                                 &next->operand1))
+        return false;
+
+    const ir_operand* src = &node->operand2;
+    if (!is_imm32(src) && !(is_mem(src) && !uses_reg(src, IR_REG_RSP)))
+        return false;
+    if (!is_reg_dead_after(next, node->operand1.reg))
+        return false;
+
+    next->operand1 = *src;
+    remove_after(prev);
+    stats->hits[PEEPHOLE_PUSH_DIRECT]++;
+    return true;
+}
+
+static bool rule_move_forward(ir_node* prev, ir_node* node,
+                              peephole_stats* stats,
+                              const block_liveness* live)
+{
+    ir_node* next = node->next;
+    if (node->operation != IR_MOV || !is_reg(&node->operand1))
+        return false;
+    if (live && (next == live->end || !next->is_valid))
+        return false;
+
+    const ir_reg reg = node->operand1.reg;
+    const ir_operand* src = &node->operand2;
+    if (!is_same_reg(&node->operand1, &next->operand2)
+            || uses_reg(&next->operand1, reg)
+            || uses_reg(src, IR_REG_RSP))
+        return false;
+
+    if (!accepts_operand(next->operation, src))
+        return false;
+    if (next->operation == IR_MOV && !is_valid_move(&next->operand1, src))
+        return false;
+    if (next->operation != IR_MOV && !is_reg(&next->operand1))
+        return false;
+    if (!is_dead_after(next, (reg_set) 1 << reg, live))
+        return false;
+
+    next->operand2 = *src;
+    remove_after(prev);
+    stats->hits[PEEPHOLE_MOVE_FORWARD]++;
+    return true;
+}
+
+static bool rule_dead_write(ir_node* prev, ir_node* node, peephole_stats* stats,
+                            const block_liveness* live)
+{
+    const ir_operand* dst = &node->operand1;
+    const ir_operand* src = &node->operand2;
+    if (!is_reg(dst))
+        return false;
+
+    const reg_set dst_bit = (reg_set) 1 << dst->reg;
+    bool is_dead = false;
+    if (node->operation == IR_MOV)
+        is_dead = is_same_reg(dst, src) || is_dead_after(node, dst_bit, live);
+    else if (node->operation == IR_XOR && is_same_reg(dst, src))
+        is_dead = is_dead_after(node, dst_bit | FLAGS_BIT, live);
+
+    if (!is_dead)
+        return false;
+
+    remove_after(prev);
+    stats->hits[live ? PEEPHOLE_GLOBAL_DEAD_WRITE : PEEPHOLE_DEAD_WRITE]++;
+    return true;
+}
+
+static bool apply_rules(ir_node* prev, ir_node* node, peephole_stats* stats)
+{
+    if (!node->is_valid)
+        return false;
+
+    if (rule_dead_write(prev, node, stats, NULL))
+        return true;
+
+    ir_node* next = node->next;
+    if (!next || !next->is_valid)   // Labels separate windows, as jumps can
+        return false;               // land between instructions
+
+    return rule_push_pop    (prev, node, stats)
+        || rule_push_direct (prev, node, stats)
+        || rule_move_forward(prev, node, stats, NULL);
+}
+
+/* Find registers live at the end of each block */
+static reg_set* compute_live_out(const ir_cfg* cfg)
+{
+    reg_set* used     = (reg_set*) calloc(cfg->block_cnt, sizeof(*used));
+    reg_set* defined  = (reg_set*) calloc(cfg->block_cnt, sizeof(*defined));
+    reg_set* live_in  = (reg_set*) calloc(cfg->block_cnt, sizeof(*live_in));
+    reg_set* live_out = (reg_set*) calloc(cfg->block_cnt, sizeof(*live_out));
+
+    for (size_t i = 0; i < cfg->block_cnt; ++i)
+    {
+        const ir_node* end = cfg->blocks[i].last->next;
+        for (const ir_node* node = cfg->blocks[i].first; node != end;
+                                                         node = node->next)
+        {
+            reg_set read = 0, kill = 0;
+            get_node_effect(node, &read, &kill);
+            used[i]    |= read & ~defined[i];
+            defined[i] |= kill;
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = cfg->block_cnt; i-- > 0;)
+        {
+            const ir_block* block = &cfg->blocks[i];
+            reg_set out = block->has_exit ? ALL_REGS : 0;
+            for (size_t j = 0; j < block->succ_cnt; ++j)
+                out |= live_in[block->succ[j]];
+
+            reg_set in = used[i] | (out & ~defined[i]);
+            if (out != live_out[i] || in != live_in[i])
+                changed = true;
+            live_out[i] = out;
+            live_in[i]  = in;
+        }
+    }
+
+    free(live_in);
+    free(defined);
+    free(used);
+    return live_out;
+}
+
+/* Skip labels to reach the instruction executed next */
+static inline const ir_node* skip_labels(const ir_node* node)
+{
+    while (node && !node->is_valid)
+        node = node->next;
+    return node;
+}
+
+/* Remove blocks, which are not reachable from any entry, and jumps to
+ * the following instruction */
+static bool remove_dead_code(ir_node* ir_list_head, const ir_cfg* cfg,
+                             peephole_stats* stats)
+{
+    bool changed = false;
+    size_t block = 0;
+    ir_node* prev = ir_list_head;
+    while (prev->next)
+    {
+        ir_node* node = prev->next;
+        while (block + 1 < cfg->block_cnt && node == cfg->blocks[block + 1].first)
+            ++block;
+
+        const ir_block* current = &cfg->blocks[block];
+        bool is_unreachable = !current->is_reachable;
+        bool is_jump_next = node->operation == IR_JMP && node->jump_target
+                         && skip_labels(node->jump_target)
+                                    == skip_labels(node->next);
+
+        if (node->is_valid && (is_unreachable || is_jump_next))
+        {
+            remove_after(prev);
+            stats->hits[is_unreachable ? PEEPHOLE_UNREACHABLE
+                                       : PEEPHOLE_JUMP_NEXT]++;
+            changed = true;
+        }
+        else
+            prev = node;
+    }
+
+    return changed;
+}
+
+static bool apply_global_rules(ir_node* ir_list_head, peephole_stats* stats)
+{
+    ir_cfg cfg = {};
+    ir_cfg_ctor(&cfg, ir_list_head);
+
+    /* Removed nodes may start blocks, so CFG is rebuilt before next rules */
+    if (remove_dead_code(ir_list_head, &cfg, stats))
+    {
+        ir_cfg_dtor(&cfg);
+        return true;
+    }
+
+    reg_set* live_out = compute_live_out(&cfg);
+
+    bool changed = false;
+    size_t block = 0;
+    ir_node* prev = ir_list_head;
+    while (prev->next)
+    {
+        ir_node* node = prev->next;
+        while (block + 1 < cfg.block_cnt && node == cfg.blocks[block + 1].first)
+            ++block;
+
+        const block_liveness live = {
+            .end      = block + 1 < cfg.block_cnt ? cfg.blocks[block + 1].first
+                                                  : NULL,
+            .live_out = live_out[block]
+        };
+        if (node->is_valid && (rule_dead_write  (prev, node, stats, &live)
+                            || rule_move_forward(prev, node, stats, &live)))
+            changed = true;     // Re-examine rules at the same position
+        else
+            prev = node;
+    }
+
+    free(live_out);
+    ir_cfg_dtor(&cfg);
+    return changed;
+}
+
+static void remove_invalid_nodes(ir_node* ir_list_head, peephole_stats* stats)
+{
+    // Every removed node remembers the instruction following it
+    ir_node* first_pending = NULL;
+    for (ir_node* current = ir_list_head->next; current; current = current->next)
+    {
+        if (!current->is_valid)
+        {
+            if (!first_pending) first_pending = current;
+            continue;
+        }
+        for (ir_node* pending = first_pending; pending && pending != current;
+                                               pending = pending->next)
+            pending->jump_target = current;
+        first_pending = NULL;
+    }
+
+    for (ir_node* current = ir_list_head; current; current = current->next)
+    {
+        ir_node* target = current->jump_target;
+        if (current->is_valid && target && !target->is_valid
+                              && target->jump_target)
+            current->jump_target = target->jump_target;
+    }
+
+    ir_node* prev = ir_list_head;
+    while (prev->next)
+    {
+        ir_node* current = prev->next;
+        if (!current->is_valid && current->jump_target)
+        {
+            remove_after(prev);
+            stats->hits[PEEPHOLE_INVALID_NODE]++;
+        }
+        else
+            prev = current;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file ir_peephole.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief Windowed peephole optimizer for backend IR
+ *
+ * @version 0.1
+ * @date 2023-05-24
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __COMPILER_IR_PEEPHOLE_H
+#define __COMPILER_IR_PEEPHOLE_H
+
+#include <stdio.h>
+
+#include "data_structures/intermediate_repr/ir.h"
+
+/**
+ * @brief Peephole optimization rules
+ */
+enum peephole_rule
+{
+    PEEPHOLE_PUSH_POP_SAME,     /* push r;    pop r     ->                  */
+    PEEPHOLE_PUSH_POP_MOVE,     /* push a;    pop b     -> mov b, a         */
+    PEEPHOLE_PUSH_DIRECT,       /* mov r, x;  push r    -> push x           */
+    PEEPHOLE_MOVE_FORWARD,      /* mov r, x;  mov y, r  -> mov y, x         */
+    PEEPHOLE_DEAD_WRITE,        /* mov r, x / xor r, r  -> (r is not used)  */
+    PEEPHOLE_GLOBAL_DEAD_WRITE, /* same, but r is not live on any CFG path */
+    PEEPHOLE_UNREACHABLE,       /* unreachable block    ->                  */
+    PEEPHOLE_JUMP_NEXT,         /* jmp L;     L:        -> L:               */
+    PEEPHOLE_INVALID_NODE,      /* empty or zeroed node ->                  */
+
+    PEEPHOLE_RULE_COUNT
+};
+
+/**
+ * @brief Number of times each peephole rule was applied
+ */
+struct peephole_stats
+{
+    size_t hits[PEEPHOLE_RULE_COUNT];
+};
+
+/**
+ * @brief Optimize IR list by replacing short instruction sequences with
+ * cheaper equivalents. Register writes, which are not read on any path
+ * through control flow graph, are removed together with blocks, which
+ * cannot be reached from program or function entries. Empty nodes are removed and
+ * jumps to them are redirected to the following instruction.
+ *
+ * @param[inout] ir_list_head	Head of IR list (never removed)
+ * @param[inout] stats          Rule hit counters (can be `NULL`)
+ *
+ */
+void ir_peephole_optimize(ir_node* ir_list_head, peephole_stats* stats);
+
+/**
+ * @brief Print peephole rule hit counters
+ *
+ * @param[in] stats     Rule hit counters
+ * @param[in] output    Output stream
+ *
+ */
+void peephole_stats_print(const peephole_stats* stats, FILE* output);
+
+#endif /* ir_peephole.h */
@@ -0,0 +1,449 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "reg_alloc.h"
+
+static const size_t NO_LOOP = (size_t) -1;
+
+struct live_interval
+{
+    const ast_node* decl;
+    const char*     name;
+    size_t          start;
+    size_t          end;
+    size_t          extend_loop;    // Last outermost loop using variable,
+                                    // which was declared before loop start
+    ir_reg          reg;
+
+    bool            is_global;      // Global cached during loop
+    bool            is_modified;    // Global is assigned inside loop
+    bool            is_fixed;       // Argument stays in its register
+    bool            is_memory;      // Variable is never put in register
+};
+
+struct loop_info
+{
+    const ast_node* node;
+    size_t          start;
+    size_t          end;
+    bool            has_return;     // Loop can be left without reaching its
+                                    // end, so cached globals are not stored
+};
+
+/* Program is numbered in order of compilation: every declaration, variable
+ * use and assignment get their own position */
+struct liveness_walk
+{
+    const reg_alloc_params* params;
+
+    live_interval*  intervals;
+    size_t          interval_cnt;
+
+    size_t*         scope;          // Visible declarations, innermost last
+    size_t          scope_size;
+
+    loop_info*      loops;
+    size_t          loop_cnt;
+    size_t*         loop_stack;     // Loops containing current position
+    size_t          loop_depth;
+
+    size_t          pos;
+    size_t          arg_idx;
+};
+
+static size_t count_nodes(const ast_node* node);
+static void walk_node(const ast_node* node, liveness_walk* walk);
+static void close_intervals(liveness_walk* walk);
+static void linear_scan(liveness_walk* walk);
+static void fill_allocation(reg_allocation* alloc, const liveness_walk* walk);
+
+void reg_allocation_ctor(reg_allocation* alloc, const ast_node* func,
+                         const reg_alloc_params* params)
+{
+    const size_t node_cnt = count_nodes(func);
+
+    liveness_walk walk = {
+        .params       = params,
+        .intervals    = (live_interval*) calloc(node_cnt, sizeof(live_interval)),
+        .interval_cnt = 0,
+        .scope        = (size_t*) calloc(node_cnt, sizeof(size_t)),
+        .scope_size   = 0,
+        .loops        = (loop_info*) calloc(node_cnt, sizeof(loop_info)),
+        .loop_cnt     = 0,
+        .loop_stack   = (size_t*) calloc(node_cnt, sizeof(size_t)),
+        .loop_depth   = 0,
+        .pos          = 0,
+        .arg_idx      = 0
+    };
+
+    walk_node(func, &walk);
+    close_intervals(&walk);
+    linear_scan(&walk);
+    fill_allocation(alloc, &walk);
+
+    free(walk.loop_stack);
+    free(walk.loops);
+    free(walk.scope);
+    free(walk.intervals);
+}
+
+void reg_allocation_dtor(reg_allocation* alloc)
+{
+    free(alloc->vars);
+    free(alloc->saved_regs);
+    memset(alloc, 0, sizeof(*alloc));
+}
+
+ir_reg reg_allocation_find(const reg_allocation* alloc, const ast_node* decl)
+{
+    for (size_t i = 0; i < alloc->var_cnt; ++i)
+        if (alloc->vars[i].decl == decl && !alloc->vars[i].is_global)
+            return alloc->vars[i].reg;
+    return IR_REG_NONE;
+}
+
+ir_reg reg_allocation_find_global(const reg_allocation* alloc,
+                                  const ast_node* loop, const char* name)
+{
+    for (size_t i = 0; i < alloc->var_cnt; ++i)
+    {
+        const var_register* var = &alloc->vars[i];
+        if (var->is_global && var->decl == loop && strcmp(var->name, name) == 0)
+            return var->reg;
+    }
+    return IR_REG_NONE;
+}
+
+static size_t count_nodes(const ast_node* node)
+{
+    if (!node)
+        return 0;
+    return 1 + count_nodes(node->left) + count_nodes(node->right);
+}
+
+static void declare_var(const ast_node* node, liveness_walk* walk)
+{
+    live_interval* added = &walk->intervals[walk->interval_cnt];
+    *added = {
+        .decl        = node,
+        .name        = node->value.name,
+        .start       = walk->pos++,
+        .end         = 0,
+        .extend_loop = NO_LOOP,
+        .reg         = IR_REG_NONE,
+        .is_global   = false,
+        .is_modified = false,
+        .is_fixed    = false,
+        .is_memory   = false
+    };
+    added->end = added->start;
+
+    if (node->type == NODE_ARG)
+    {
+        const size_t idx = walk->arg_idx++;
+        if (idx >= walk->params->arg_reg_cnt)   // Stack argument
+            added->is_memory = true;
+        else if (walk->params->is_leaf)
+        {
+            added->is_fixed = true;
+            added->reg = walk->params->arg_regs[idx];
+        }
+    }
+
+    walk->scope[walk->scope_size++] = walk->interval_cnt++;
+}
+
+static void use_global(const char* name, bool is_def, liveness_walk* walk)
+{
+    if (!walk->params->is_leaf || walk->loop_depth == 0)
+        return;
+
+    const size_t loop = walk->loop_stack[0];
+    for (size_t i = 0; i < walk->interval_cnt; ++i)
+    {
+        live_interval* interval = &walk->intervals[i];
+        if (interval->is_global && interval->extend_loop == loop
+                                && strcmp(interval->name, name) == 0)
+        {
+            interval->is_modified |= is_def;
+            return;
+        }
+    }
+
+    walk->intervals[walk->interval_cnt++] = {
+        .decl        = walk->loops[loop].node,
+        .name        = name,
+        .start       = 0,
+        .end         = 0,
+        .extend_loop = loop,
+        .reg         = IR_REG_NONE,
+        .is_global   = true,
+        .is_modified = is_def,
+        .is_fixed    = false,
+        .is_memory   = false
+    };
+}
+
+static void use_var(const char* name, bool is_def, liveness_walk* walk)
+{
+    const size_t pos = walk->pos++;
+
+    size_t found = walk->scope_size;
+    for (size_t i = walk->scope_size; i > 0; --i)
+        if (strcmp(walk->intervals[walk->scope[i - 1]].name, name) == 0)
+        {
+            found = i - 1;
+            break;
+        }
+
+    if (found == walk->scope_size)
+    {
+        use_global(name, is_def, walk);
+        return;
+    }
+
+    live_interval* interval = &walk->intervals[walk->scope[found]];
+    interval->end = pos;
+
+    // Value must survive jump back to the start of outermost loop, which
+    // was entered after declaration. This loop ends no earlier than loops
+    // of previous uses: they are either closed already or contain it.
+    for (size_t i = 0; i < walk->loop_depth; ++i)
+    {
+        const size_t loop = walk->loop_stack[i];
+        if (walk->loops[loop].start < interval->start)
+            continue;
+        interval->extend_loop = loop;
+        break;
+    }
+}
+
+static void walk_node(const ast_node* node, liveness_walk* walk)
+{
+    if (!node)
+        return;
+
+    if (node->type == NODE_VAR)
+    {
+        use_var(node->value.name, false, walk);
+        return;
+    }
+
+    if (node->type == NODE_ASS)
+    {
+        walk_node(node->right, walk);
+        use_var(node->value.name, true, walk);
+        return;
+    }
+
+    if (node->type == NODE_NVAR)
+    {
+        walk_node(node->right, walk);
+        declare_var(node, walk);
+        return;
+    }
+
+    if (node->type == NODE_ARG)
+    {
+        declare_var(node, walk);
+        walk_node(node->right, walk);
+        return;
+    }
+
+    if (node->type == NODE_BLOCK)
+    {
+        const size_t scope_size = walk->scope_size;
+        walk_node(node->left, walk);
+        walk_node(node->right, walk);
+        walk->scope_size = scope_size;
+        return;
+    }
+
+    if (node->type == NODE_WHILE)
+    {
+        const size_t loop = walk->loop_cnt++;
+        walk->loops[loop] = {
+            .node       = node,
+            .start      = walk->pos++,
+            .end        = 0,
+            .has_return = false
+        };
+        walk->loop_stack[walk->loop_depth++] = loop;
+        walk_node(node->left, walk);
+        walk_node(node->right, walk);
+        walk->loop_depth--;
+        walk->loops[loop].end = walk->pos++;
+        return;
+    }
+
+    if (node->type == NODE_RET)
+        for (size_t i = 0; i < walk->loop_depth; ++i)
+            walk->loops[walk->loop_stack[i]].has_return = true;
+
+    walk_node(node->left, walk);
+    walk_node(node->right, walk);
+}
+
+static void close_intervals(liveness_walk* walk)
+{
+    for (size_t i = 0; i < walk->interval_cnt; ++i)
+    {
+        live_interval* interval = &walk->intervals[i];
+        if (interval->extend_loop == NO_LOOP)
+            continue;
+
+        const loop_info* loop = &walk->loops[interval->extend_loop];
+        if (interval->is_global)
+        {
+            interval->start = loop->start;
+            interval->end   = loop->end;
+            // Only values written inside loop are worth a register
+            if (loop->has_return || !interval->is_modified)
+                interval->is_memory = true;
+        }
+        else if (loop->end > interval->end)
+            interval->end = loop->end;
+    }
+}
+
+static int compare_start(const void* lhs, const void* rhs)
+{
+    const live_interval* a = *(const live_interval* const*) lhs;
+    const live_interval* b = *(const live_interval* const*) rhs;
+    if (a->start != b->start)
+        return a->start < b->start ? -1 : 1;
+    return a < b ? -1 : (a > b);
+}
+
+/* Insert interval into list of active intervals sorted by end */
+static void add_active(live_interval** active, size_t* active_cnt,
+                       live_interval* interval)
+{
+    size_t i = *active_cnt;
+    for (; i > 0 && active[i - 1]->end > interval->end; --i)
+        active[i] = active[i - 1];
+    active[i] = interval;
+    ++*active_cnt;
+}
+
+static void remove_active(live_interval** active, size_t* active_cnt,
+                          size_t idx)
+{
+    for (size_t i = idx + 1; i < *active_cnt; ++i)
+        active[i - 1] = active[i];
+    --*active_cnt;
+}
+
+static ir_reg get_free_reg(const reg_alloc_params* params, const bool* is_free)
+{
+    for (size_t i = 0; i < params->free_reg_cnt; ++i)
+        if (is_free[params->free_regs[i]])
+            return params->free_regs[i];
+    for (size_t i = 0; i < params->saved_reg_cnt; ++i)
+        if (is_free[params->saved_regs[i]])
+            return params->saved_regs[i];
+    return IR_REG_NONE;
+}
+
+static void linear_scan(liveness_walk* walk)
+{
+    const reg_alloc_params* params = walk->params;
+    const size_t cnt = walk->interval_cnt;
+
+    live_interval** order  = (live_interval**) calloc(cnt, sizeof(*order));
+    live_interval** active = (live_interval**) calloc(cnt, sizeof(*active));
+    size_t active_cnt = 0;
+
+    for (size_t i = 0; i < cnt; ++i)
+        order[i] = &walk->intervals[i];
+    qsort(order, cnt, sizeof(*order), compare_start);
+
+    bool is_free[IR_REG_XMM15 + 1] = {};
+    for (size_t i = 0; i < params->free_reg_cnt; ++i)
+        is_free[params->free_regs[i]] = true;
+    for (size_t i = 0; i < params->saved_reg_cnt; ++i)
+        is_free[params->saved_regs[i]] = true;
+    for (size_t i = 0; i < cnt; ++i)
+        if (order[i]->is_fixed)
+            is_free[order[i]->reg] = false;
+
+    for (size_t i = 0; i < cnt; ++i)
+    {
+        live_interval* current = order[i];
+        if (current->is_memory)
+            continue;
+
+        while (active_cnt > 0 && active[0]->end < current->start)
+        {
+            is_free[active[0]->reg] = true;
+            remove_active(active, &active_cnt, 0);
+        }
+
+        if (current->is_fixed)
+        {
+            add_active(active, &active_cnt, current);
+            continue;
+        }
+
+        ir_reg reg = get_free_reg(params, is_free);
+        if (reg != IR_REG_NONE)
+        {
+            current->reg = reg;
+            is_free[reg] = false;
+            add_active(active, &active_cnt, current);
+            continue;
+        }
+
+        // Out of registers: interval ending last stays in memory
+        size_t spill = active_cnt;
+        while (spill > 0 && active[spill - 1]->is_fixed)
+            --spill;
+        if (spill == 0 || active[spill - 1]->end <= current->end)
+            continue;
+
+        current->reg = active[spill - 1]->reg;
+        active[spill - 1]->reg = IR_REG_NONE;
+        remove_active(active, &active_cnt, spill - 1);
+        add_active(active, &active_cnt, current);
+    }
+
+    free(active);
+    free(order);
+}
+
+static void fill_allocation(reg_allocation* alloc, const liveness_walk* walk)
+{
+    const reg_alloc_params* params = walk->params;
+
+    alloc->vars = (var_register*) calloc(walk->interval_cnt,
+                                         sizeof(*alloc->vars));
+    alloc->var_cnt     = walk->interval_cnt;
+    alloc->decl_cnt    = 0;
+    alloc->all_in_regs = true;
+
+    bool is_used[IR_REG_XMM15 + 1] = {};
+    for (size_t i = 0; i < walk->interval_cnt; ++i)
+    {
+        const live_interval* interval = &walk->intervals[i];
+        alloc->vars[i] = {
+            .decl      = interval->decl,
+            .name      = interval->name,
+            .reg       = interval->reg,
+            .is_global = interval->is_global
+        };
+        is_used[interval->reg] = true;
+
+        if (interval->is_global)
+            continue;
+        ++alloc->decl_cnt;
+        if (interval->reg == IR_REG_NONE)
+            alloc->all_in_regs = false;
+    }
+
+    alloc->saved_regs = (ir_reg*) calloc(params->saved_reg_cnt,
+                                         sizeof(*alloc->saved_regs));
+    alloc->saved_cnt  = 0;
+    for (size_t i = 0; i < params->saved_reg_cnt; ++i)
+        if (is_used[params->saved_regs[i]])
+            alloc->saved_regs[alloc->saved_cnt++] = params->saved_regs[i];
+}
@@ -0,0 +1,110 @@
+/**
+ * @file reg_alloc.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief Linear-scan allocation of registers to variables
+ *
+ * @version 0.1
+ * @date 2023-05-31
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __COMPILER_REG_ALLOC_H
+#define __COMPILER_REG_ALLOC_H
+
+#include <stddef.h>
+
+#include "data_structures/ast/ast.h"
+#include "data_structures/intermediate_repr/ir.h"
+
+/**
+ * @brief Registers available to allocator
+ */
+struct reg_alloc_params
+{
+    const ir_reg*   arg_regs;       // Registers holding first arguments
+    size_t          arg_reg_cnt;    // Number of arguments passed in registers
+
+    const ir_reg*   free_regs;      // Registers, which can be clobbered
+    size_t          free_reg_cnt;
+    const ir_reg*   saved_regs;     // Registers, which must be preserved
+    size_t          saved_reg_cnt;
+
+    bool            is_leaf;        // Function makes no calls: arguments
+                                    // stay in `arg_regs` and globals
+                                    // modified by loops are cached
+};
+
+/**
+ * @brief Register assigned to variable declaration
+ */
+struct var_register
+{
+    const ast_node* decl;       // ARG or NVAR node, or WHILE for globals
+    const char*     name;       // Variable name
+    ir_reg          reg;        // Assigned register or `IR_REG_NONE`
+    bool            is_global;  // Global variable cached during loop
+};
+
+/**
+ * @brief Result of register allocation for single function
+ */
+struct reg_allocation
+{
+    var_register*   vars;
+    size_t          var_cnt;
+    size_t          decl_cnt;       // Number of ARG and NVAR nodes
+
+    ir_reg*         saved_regs;     // Preserved registers used by function
+    size_t          saved_cnt;
+
+    bool            all_in_regs;    // No declared variable is kept in memory
+};
+
+/**
+ * @brief Assign registers to arguments and local variables of function.
+ * Live interval of each variable spans from its declaration to its last
+ * use in statement order and covers every loop, which uses the variable
+ * declared outside of it. Intervals are then scanned in order of their
+ * start, and when registers run out, the interval ending last is left in
+ * memory.
+ *
+ * @param[out] alloc    Constructed allocation
+ * @param[in]  func     NFUN node of function
+ * @param[in]  params   Available registers
+ *
+ */
+void reg_allocation_ctor(reg_allocation* alloc, const ast_node* func,
+                         const reg_alloc_params* params);
+
+/**
+ * @brief Destroy register allocation
+ *
+ * @param[inout] alloc  Destroyed allocation
+ *
+ */
+void reg_allocation_dtor(reg_allocation* alloc);
+
+/**
+ * @brief Get register assigned to variable declaration
+ *
+ * @param[in] alloc     Register allocation
+ * @param[in] decl      ARG or NVAR node
+ *
+ * @return Assigned register or `IR_REG_NONE`
+ */
+ir_reg reg_allocation_find(const reg_allocation* alloc, const ast_node* decl);
+
+/**
+ * @brief Get register caching global variable during loop
+ *
+ * @param[in] alloc     Register allocation
+ * @param[in] loop      Outermost WHILE node
+ * @param[in] name      Global variable name
+ *
+ * @return Assigned register or `IR_REG_NONE`
+ */
+ir_reg reg_allocation_find_global(const reg_allocation* alloc,
+                                  const ast_node* loop, const char* name);
+
+#endif /* reg_alloc.h */
@@ -0,0 +1,319 @@
+/**
+ * @file stdlib_image.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief Prebuilt standard library variants and their symbol tables
+ *
+ * Generated by 'assets/embed_stdlib.py' from 'assets/stdlib*.asm', do not
+ * edit manually. Run 'make stdlib' after changing standard library sources.
+ */
+#ifndef __COMPILER_STDLIB_IMAGE_H
+#define __COMPILER_STDLIB_IMAGE_H
+
+#include <stddef.h>
+
+/**
+ * @brief Label of standard library binary
+ */
+struct stdlib_symbol
+{
+    const char* name;
+    size_t      offset;     // Offset from the start of binary
+};
+
+/**
+ * @brief Standard library binary with its labels sorted by offset
+ */
+struct stdlib_image
+{
+    const unsigned char* code;
+    size_t               size;
+    const stdlib_symbol* symbols;
+    size_t               symbol_cnt;
+};
+
+// stdlib.asm
+static constexpr unsigned char stdlib_dec_code[] = {
+    0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0x48, 0x8B, 0x45, 0x10,
+    0x4D, 0x31, 0xC0, 0x48, 0x85, 0xC0, 0x7D, 0x06, 0x48, 0xF7, 0xD8, 0x49,
+    0xFF, 0xC0, 0x4C, 0x8D, 0x0D, 0x37, 0x01, 0x00, 0x00, 0x48, 0x8D, 0x7D,
+    0xFF, 0xC6, 0x07, 0x0A, 0x48, 0x89, 0xC6, 0x48, 0xC1, 0xE8, 0x03, 0x48,
+    0xBA, 0xCF, 0xF7, 0x53, 0xE3, 0xA5, 0x9B, 0xC4, 0x20, 0x48, 0xF7, 0xE2,
+    0x48, 0xC1, 0xEA, 0x04, 0x48, 0x69, 0xC2, 0xE8, 0x03, 0x00, 0x00, 0x48,
+    0x29, 0xC6, 0x48, 0x89, 0xD0, 0x6B, 0xCE, 0x29, 0xC1, 0xE9, 0x0C, 0x6B,
+    0xD1, 0x64, 0x29, 0xD6, 0x41, 0x0F, 0xB7, 0x14, 0x71, 0x48, 0x83, 0xEF,
+    0x02, 0x66, 0x89, 0x17, 0x80, 0xC1, 0x30, 0x48, 0xFF, 0xCF, 0x88, 0x0F,
+    0x48, 0xFF, 0xCF, 0xC6, 0x07, 0x2E, 0x48, 0x83, 0xF8, 0x64, 0x72, 0x30,
+    0x48, 0x89, 0xC6, 0x48, 0xC1, 0xE8, 0x02, 0x48, 0xBA, 0xC3, 0xF5, 0x28,
+    0x5C, 0x8F, 0xC2, 0xF5, 0x28, 0x48, 0xF7, 0xE2, 0x48, 0xC1, 0xEA, 0x02,
+    0x48, 0x6B, 0xC2, 0x64, 0x48, 0x29, 0xC6, 0x48, 0x89, 0xD0, 0x41, 0x0F,
+    0xB7, 0x14, 0x71, 0x48, 0x83, 0xEF, 0x02, 0x66, 0x89, 0x17, 0xEB, 0xCA,
+    0x48, 0x83, 0xF8, 0x0A, 0x72, 0x0E, 0x41, 0x0F, 0xB7, 0x14, 0x41, 0x48,
+    0x83, 0xEF, 0x02, 0x66, 0x89, 0x17, 0xEB, 0x07, 0x04, 0x30, 0x48, 0xFF,
+    0xCF, 0x88, 0x07, 0x4D, 0x85, 0xC0, 0x74, 0x06, 0x48, 0xFF, 0xCF, 0xC6,
+    0x07, 0x2D, 0x48, 0x89, 0xE9, 0x48, 0x29, 0xF9, 0x48, 0x8B, 0x14, 0x25,
+    0x00, 0xF0, 0x5D, 0x00, 0x48, 0x8D, 0x04, 0x0A, 0x48, 0x3D, 0x00, 0x00,
+    0x01, 0x00, 0x76, 0x0A, 0x51, 0xE8, 0x2E, 0x00, 0x00, 0x00, 0x59, 0x48,
+    0x31, 0xD2, 0x48, 0x8D, 0xBA, 0x00, 0x00, 0x5F, 0x00, 0x48, 0x89, 0xEE,
+    0x48, 0x29, 0xCE, 0x48, 0x01, 0xCA, 0x48, 0x89, 0x14, 0x25, 0x00, 0xF0,
+    0x5D, 0x00, 0xF3, 0xA4, 0x48, 0x83, 0xC4, 0x20, 0x5D, 0x80, 0x3C, 0x25,
+    0x08, 0xF0, 0x5D, 0x00, 0x00, 0x75, 0x01, 0xC3, 0x48, 0xC7, 0xC6, 0x00,
+    0x00, 0x5F, 0x00, 0x48, 0x8B, 0x14, 0x25, 0x00, 0xF0, 0x5D, 0x00, 0x48,
+    0x85, 0xD2, 0x7E, 0x1B, 0xBF, 0x01, 0x00, 0x00, 0x00, 0x48, 0xC7, 0xC0,
+    0x01, 0x00, 0x00, 0x00, 0x0F, 0x05, 0x48, 0x85, 0xC0, 0x7E, 0x08, 0x48,
+    0x01, 0xC6, 0x48, 0x29, 0xC2, 0xEB, 0xE0, 0x48, 0xC7, 0x04, 0x25, 0x00,
+    0xF0, 0x5D, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC3, 0x30, 0x30, 0x30, 0x31,
+    0x30, 0x32, 0x30, 0x33, 0x30, 0x34, 0x30, 0x35, 0x30, 0x36, 0x30, 0x37,
+    0x30, 0x38, 0x30, 0x39, 0x31, 0x30, 0x31, 0x31, 0x31, 0x32, 0x31, 0x33,
+    0x31, 0x34, 0x31, 0x35, 0x31, 0x36, 0x31, 0x37, 0x31, 0x38, 0x31, 0x39,
+    0x32, 0x30, 0x32, 0x31, 0x32, 0x32, 0x32, 0x33, 0x32, 0x34, 0x32, 0x35,
+    0x32, 0x36, 0x32, 0x37, 0x32, 0x38, 0x32, 0x39, 0x33, 0x30, 0x33, 0x31,
+    0x33, 0x32, 0x33, 0x33, 0x33, 0x34, 0x33, 0x35, 0x33, 0x36, 0x33, 0x37,
+    0x33, 0x38, 0x33, 0x39, 0x34, 0x30, 0x34, 0x31, 0x34, 0x32, 0x34, 0x33,
+    0x34, 0x34, 0x34, 0x35, 0x34, 0x36, 0x34, 0x37, 0x34, 0x38, 0x34, 0x39,
+    0x35, 0x30, 0x35, 0x31, 0x35, 0x32, 0x35, 0x33, 0x35, 0x34, 0x35, 0x35,
+    0x35, 0x36, 0x35, 0x37, 0x35, 0x38, 0x35, 0x39, 0x36, 0x30, 0x36, 0x31,
+    0x36, 0x32, 0x36, 0x33, 0x36, 0x34, 0x36, 0x35, 0x36, 0x36, 0x36, 0x37,
+    0x36, 0x38, 0x36, 0x39, 0x37, 0x30, 0x37, 0x31, 0x37, 0x32, 0x37, 0x33,
+    0x37, 0x34, 0x37, 0x35, 0x37, 0x36, 0x37, 0x37, 0x37, 0x38, 0x37, 0x39,
+    0x38, 0x30, 0x38, 0x31, 0x38, 0x32, 0x38, 0x33, 0x38, 0x34, 0x38, 0x35,
+    0x38, 0x36, 0x38, 0x37, 0x38, 0x38, 0x38, 0x39, 0x39, 0x30, 0x39, 0x31,
+    0x39, 0x32, 0x39, 0x33, 0x39, 0x34, 0x39, 0x35, 0x39, 0x36, 0x39, 0x37,
+    0x39, 0x38, 0x39, 0x39, 0x55, 0x48, 0x89, 0xE5, 0x48, 0x8B, 0x34, 0x25,
+    0x10, 0xF0, 0x5D, 0x00, 0x4C, 0x8B, 0x04, 0x25, 0x18, 0xF0, 0x5D, 0x00,
+    0x4D, 0x31, 0xC9, 0x49, 0xC7, 0xC2, 0x01, 0x00, 0x00, 0x00, 0xE8, 0x8F,
+    0x00, 0x00, 0x00, 0x48, 0x83, 0xFA, 0x20, 0x77, 0x05, 0x48, 0xFF, 0xC6,
+    0xEB, 0xF0, 0x48, 0x83, 0xFA, 0x2D, 0x75, 0x06, 0x49, 0xF7, 0xDA, 0x48,
+    0xFF, 0xC6, 0xE8, 0x73, 0x00, 0x00, 0x00, 0x48, 0x83, 0xEA, 0x30, 0x48,
+    0x83, 0xFA, 0x09, 0x77, 0x0C, 0x4D, 0x6B, 0xC9, 0x0A, 0x49, 0x01, 0xD1,
+    0x48, 0xFF, 0xC6, 0xEB, 0xE5, 0x48, 0x83, 0xFA, 0xFE, 0x75, 0x3B, 0x48,
+    0xFF, 0xC6, 0x49, 0xC7, 0xC7, 0x03, 0x00, 0x00, 0x00, 0xE8, 0x48, 0x00,
+    0x00, 0x00, 0x48, 0x83, 0xEA, 0x30, 0x48, 0x83, 0xFA, 0x09, 0x77, 0x14,
+    0x48, 0xFF, 0xC6, 0x4D, 0x85, 0xFF, 0x74, 0xE9, 0x4D, 0x6B, 0xC9, 0x0A,
+    0x49, 0x01, 0xD1, 0x49, 0xFF, 0xCF, 0xEB, 0xDD, 0x4D, 0x85, 0xFF, 0x74,
+    0x09, 0x4D, 0x6B, 0xC9, 0x0A, 0x49, 0xFF, 0xCF, 0xEB, 0xF2, 0x48, 0x89,
+    0x34, 0x25, 0x10, 0xF0, 0x5D, 0x00, 0x4C, 0x89, 0x04, 0x25, 0x18, 0xF0,
+    0x5D, 0x00, 0x4C, 0x89, 0xC8, 0x4C, 0x89, 0xD7, 0x48, 0x0F, 0xAF, 0xC7,
+    0x5D, 0xC3, 0x4C, 0x39, 0xC6, 0x72, 0x35, 0x48, 0x31, 0xFF, 0x48, 0xC7,
+    0xC6, 0x00, 0x00, 0x5E, 0x00, 0x48, 0xC7, 0xC2, 0x00, 0x00, 0x01, 0x00,
+    0x48, 0x31, 0xC0, 0x0F, 0x05, 0x48, 0xC7, 0xC6, 0x00, 0x00, 0x5E, 0x00,
+    0x48, 0x85, 0xC0, 0x7F, 0x03, 0x48, 0x31, 0xC0, 0x4C, 0x8D, 0x04, 0x06,
+    0x48, 0xC7, 0xC2, 0xFF, 0xFF, 0xFF, 0xFF, 0x48, 0x85, 0xC0, 0x74, 0x03,
+    0x0F, 0xB6, 0x16, 0xC3, 0x55, 0x48, 0x89, 0xE5, 0xF2, 0x48, 0x0F, 0x2A,
+    0x45, 0x10, 0xB8, 0xE8, 0x03, 0x00, 0x00, 0xF2, 0x48, 0x0F, 0x2A, 0xC8,
+    0xF2, 0x0F, 0x59, 0xC1, 0xF2, 0x0F, 0x51, 0xC0, 0xF2, 0x48, 0x0F, 0x2D,
+    0xC0, 0x5D, 0xC3,
+};
+
+static constexpr stdlib_symbol stdlib_dec_symbols[] = {
+    { "print_num",           0x000 },
+    { "print_flush",         0x11C },
+    { "digit_pairs",         0x158 },
+    { "read_num",            0x220 },
+    { "read_peek",           0x2D2 },
+    { "sqrt",                0x310 },
+    { "stdlib_end",          0x333 },
+};
+
+static constexpr stdlib_image stdlib_dec = {
+    .code       = stdlib_dec_code,
+    .size       = sizeof(stdlib_dec_code),
+    .symbols    = stdlib_dec_symbols,
+    .symbol_cnt = sizeof(stdlib_dec_symbols)
+                / sizeof(*stdlib_dec_symbols)
+};
+
+// stdlib_pow2.asm
+static constexpr unsigned char stdlib_pow2_code[] = {
+    0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0x4D, 0x31, 0xC0, 0x48,
+    0x8B, 0x45, 0x10, 0x48, 0x85, 0xC0, 0x7D, 0x06, 0x48, 0xF7, 0xD8, 0x49,
+    0xFF, 0xC0, 0xBE, 0xE8, 0x03, 0x00, 0x00, 0x48, 0xF7, 0xE6, 0x0F, 0xB6,
+    0x0D, 0x48, 0x03, 0x00, 0x00, 0x48, 0x0F, 0xAD, 0xD0, 0x48, 0x85, 0xC0,
+    0x75, 0x03, 0x4D, 0x31, 0xC0, 0x4C, 0x8D, 0x0D, 0x37, 0x01, 0x00, 0x00,
+    0x48, 0x8D, 0x7D, 0xFF, 0xC6, 0x07, 0x0A, 0x48, 0x89, 0xC6, 0x48, 0xC1,
+    0xE8, 0x03, 0x48, 0xBA, 0xCF, 0xF7, 0x53, 0xE3, 0xA5, 0x9B, 0xC4, 0x20,
+    0x48, 0xF7, 0xE2, 0x48, 0xC1, 0xEA, 0x04, 0x48, 0x69, 0xC2, 0xE8, 0x03,
+    0x00, 0x00, 0x48, 0x29, 0xC6, 0x48, 0x89, 0xD0, 0x6B, 0xCE, 0x29, 0xC1,
+    0xE9, 0x0C, 0x6B, 0xD1, 0x64, 0x29, 0xD6, 0x41, 0x0F, 0xB7, 0x14, 0x71,
+    0x48, 0x83, 0xEF, 0x02, 0x66, 0x89, 0x17, 0x80, 0xC1, 0x30, 0x48, 0xFF,
+    0xCF, 0x88, 0x0F, 0x48, 0xFF, 0xCF, 0xC6, 0x07, 0x2E, 0x48, 0x83, 0xF8,
+    0x64, 0x72, 0x30, 0x48, 0x89, 0xC6, 0x48, 0xC1, 0xE8, 0x02, 0x48, 0xBA,
+    0xC3, 0xF5, 0x28, 0x5C, 0x8F, 0xC2, 0xF5, 0x28, 0x48, 0xF7, 0xE2, 0x48,
+    0xC1, 0xEA, 0x02, 0x48, 0x6B, 0xC2, 0x64, 0x48, 0x29, 0xC6, 0x48, 0x89,
+    0xD0, 0x41, 0x0F, 0xB7, 0x14, 0x71, 0x48, 0x83, 0xEF, 0x02, 0x66, 0x89,
+    0x17, 0xEB, 0xCA, 0x48, 0x83, 0xF8, 0x0A, 0x72, 0x0E, 0x41, 0x0F, 0xB7,
+    0x14, 0x41, 0x48, 0x83, 0xEF, 0x02, 0x66, 0x89, 0x17, 0xEB, 0x07, 0x04,
+    0x30, 0x48, 0xFF, 0xCF, 0x88, 0x07, 0x4D, 0x85, 0xC0, 0x74, 0x06, 0x48,
+    0xFF, 0xCF, 0xC6, 0x07, 0x2D, 0x48, 0x89, 0xE9, 0x48, 0x29, 0xF9, 0x48,
+    0x8B, 0x14, 0x25, 0x00, 0xF0, 0x5D, 0x00, 0x48, 0x8D, 0x04, 0x0A, 0x48,
+    0x3D, 0x00, 0x00, 0x01, 0x00, 0x76, 0x0A, 0x51, 0xE8, 0x2E, 0x00, 0x00,
+    0x00, 0x59, 0x48, 0x31, 0xD2, 0x48, 0x8D, 0xBA, 0x00, 0x00, 0x5F, 0x00,
+    0x48, 0x89, 0xEE, 0x48, 0x29, 0xCE, 0x48, 0x01, 0xCA, 0x48, 0x89, 0x14,
+    0x25, 0x00, 0xF0, 0x5D, 0x00, 0xF3, 0xA4, 0x48, 0x83, 0xC4, 0x20, 0x5D,
+    0x80, 0x3C, 0x25, 0x08, 0xF0, 0x5D, 0x00, 0x00, 0x75, 0x01, 0xC3, 0x48,
+    0xC7, 0xC6, 0x00, 0x00, 0x5F, 0x00, 0x48, 0x8B, 0x14, 0x25, 0x00, 0xF0,
+    0x5D, 0x00, 0x48, 0x85, 0xD2, 0x7E, 0x1B, 0xBF, 0x01, 0x00, 0x00, 0x00,
+    0x48, 0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00, 0x0F, 0x05, 0x48, 0x85, 0xC0,
+    0x7E, 0x08, 0x48, 0x01, 0xC6, 0x48, 0x29, 0xC2, 0xEB, 0xE0, 0x48, 0xC7,
+    0x04, 0x25, 0x00, 0xF0, 0x5D, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC3, 0x30,
+    0x30, 0x30, 0x31, 0x30, 0x32, 0x30, 0x33, 0x30, 0x34, 0x30, 0x35, 0x30,
+    0x36, 0x30, 0x37, 0x30, 0x38, 0x30, 0x39, 0x31, 0x30, 0x31, 0x31, 0x31,
+    0x32, 0x31, 0x33, 0x31, 0x34, 0x31, 0x35, 0x31, 0x36, 0x31, 0x37, 0x31,
+    0x38, 0x31, 0x39, 0x32, 0x30, 0x32, 0x31, 0x32, 0x32, 0x32, 0x33, 0x32,
+    0x34, 0x32, 0x35, 0x32, 0x36, 0x32, 0x37, 0x32, 0x38, 0x32, 0x39, 0x33,
+    0x30, 0x33, 0x31, 0x33, 0x32, 0x33, 0x33, 0x33, 0x34, 0x33, 0x35, 0x33,
+    0x36, 0x33, 0x37, 0x33, 0x38, 0x33, 0x39, 0x34, 0x30, 0x34, 0x31, 0x34,
+    0x32, 0x34, 0x33, 0x34, 0x34, 0x34, 0x35, 0x34, 0x36, 0x34, 0x37, 0x34,
+    0x38, 0x34, 0x39, 0x35, 0x30, 0x35, 0x31, 0x35, 0x32, 0x35, 0x33, 0x35,
+    0x34, 0x35, 0x35, 0x35, 0x36, 0x35, 0x37, 0x35, 0x38, 0x35, 0x39, 0x36,
+    0x30, 0x36, 0x31, 0x36, 0x32, 0x36, 0x33, 0x36, 0x34, 0x36, 0x35, 0x36,
+    0x36, 0x36, 0x37, 0x36, 0x38, 0x36, 0x39, 0x37, 0x30, 0x37, 0x31, 0x37,
+    0x32, 0x37, 0x33, 0x37, 0x34, 0x37, 0x35, 0x37, 0x36, 0x37, 0x37, 0x37,
+    0x38, 0x37, 0x39, 0x38, 0x30, 0x38, 0x31, 0x38, 0x32, 0x38, 0x33, 0x38,
+    0x34, 0x38, 0x35, 0x38, 0x36, 0x38, 0x37, 0x38, 0x38, 0x38, 0x39, 0x39,
+    0x30, 0x39, 0x31, 0x39, 0x32, 0x39, 0x33, 0x39, 0x34, 0x39, 0x35, 0x39,
+    0x36, 0x39, 0x37, 0x39, 0x38, 0x39, 0x39, 0x55, 0x48, 0x89, 0xE5, 0x48,
+    0x8B, 0x34, 0x25, 0x10, 0xF0, 0x5D, 0x00, 0x4C, 0x8B, 0x04, 0x25, 0x18,
+    0xF0, 0x5D, 0x00, 0x4D, 0x31, 0xC9, 0x49, 0xC7, 0xC2, 0x01, 0x00, 0x00,
+    0x00, 0xE8, 0xA8, 0x00, 0x00, 0x00, 0x48, 0x83, 0xFA, 0x20, 0x77, 0x05,
+    0x48, 0xFF, 0xC6, 0xEB, 0xF0, 0x48, 0x83, 0xFA, 0x2D, 0x75, 0x06, 0x49,
+    0xF7, 0xDA, 0x48, 0xFF, 0xC6, 0xE8, 0x8C, 0x00, 0x00, 0x00, 0x48, 0x83,
+    0xEA, 0x30, 0x48, 0x83, 0xFA, 0x09, 0x77, 0x0C, 0x4D, 0x6B, 0xC9, 0x0A,
+    0x49, 0x01, 0xD1, 0x48, 0xFF, 0xC6, 0xEB, 0xE5, 0x48, 0x83, 0xFA, 0xFE,
+    0x75, 0x3B, 0x48, 0xFF, 0xC6, 0x49, 0xC7, 0xC7, 0x03, 0x00, 0x00, 0x00,
+    0xE8, 0x61, 0x00, 0x00, 0x00, 0x48, 0x83, 0xEA, 0x30, 0x48, 0x83, 0xFA,
+    0x09, 0x77, 0x14, 0x48, 0xFF, 0xC6, 0x4D, 0x85, 0xFF, 0x74, 0xE9, 0x4D,
+    0x6B, 0xC9, 0x0A, 0x49, 0x01, 0xD1, 0x49, 0xFF, 0xCF, 0xEB, 0xDD, 0x4D,
+    0x85, 0xFF, 0x74, 0x09, 0x4D, 0x6B, 0xC9, 0x0A, 0x49, 0xFF, 0xCF, 0xEB,
+    0xF2, 0x48, 0x89, 0x34, 0x25, 0x10, 0xF0, 0x5D, 0x00, 0x4C, 0x89, 0x04,
+    0x25, 0x18, 0xF0, 0x5D, 0x00, 0x4C, 0x89, 0xC8, 0x4C, 0x89, 0xD7, 0x0F,
+    0xB6, 0x0D, 0x83, 0x00, 0x00, 0x00, 0x48, 0x31, 0xD2, 0x48, 0x0F, 0xA5,
+    0xC2, 0x48, 0xD3, 0xE0, 0xBE, 0xE8, 0x03, 0x00, 0x00, 0x48, 0xF7, 0xF6,
+    0x48, 0x0F, 0xAF, 0xC7, 0x5D, 0xC3, 0x4C, 0x39, 0xC6, 0x72, 0x35, 0x48,
+    0x31, 0xFF, 0x48, 0xC7, 0xC6, 0x00, 0x00, 0x5E, 0x00, 0x48, 0xC7, 0xC2,
+    0x00, 0x00, 0x01, 0x00, 0x48, 0x31, 0xC0, 0x0F, 0x05, 0x48, 0xC7, 0xC6,
+    0x00, 0x00, 0x5E, 0x00, 0x48, 0x85, 0xC0, 0x7F, 0x03, 0x48, 0x31, 0xC0,
+    0x4C, 0x8D, 0x04, 0x06, 0x48, 0xC7, 0xC2, 0xFF, 0xFF, 0xFF, 0xFF, 0x48,
+    0x85, 0xC0, 0x74, 0x03, 0x0F, 0xB6, 0x16, 0xC3, 0x55, 0x48, 0x89, 0xE5,
+    0xF2, 0x48, 0x0F, 0x2A, 0x45, 0x10, 0x0F, 0xB6, 0x0D, 0x1C, 0x00, 0x00,
+    0x00, 0xB8, 0x01, 0x00, 0x00, 0x00, 0x48, 0xD3, 0xE0, 0xF2, 0x48, 0x0F,
+    0x2A, 0xC8, 0xF2, 0x0F, 0x59, 0xC1, 0xF2, 0x0F, 0x51, 0xC0, 0xF2, 0x48,
+    0x0F, 0x2D, 0xC0, 0x5D, 0xC3, 0x10,
+};
+
+static constexpr stdlib_symbol stdlib_pow2_symbols[] = {
+    { "print_num",           0x000 },
+    { "print_num.shift_ref", 0x029 },
+    { "print_flush",         0x137 },
+    { "digit_pairs",         0x173 },
+    { "read_num",            0x23B },
+    { "read_num.shift_ref",  0x2EE },
+    { "read_peek",           0x306 },
+    { "sqrt",                0x344 },
+    { "sqrt.shift_ref",      0x355 },
+    { "scale_shift",         0x371 },
+    { "stdlib_end",          0x371 },
+};
+
+static constexpr stdlib_image stdlib_pow2 = {
+    .code       = stdlib_pow2_code,
+    .size       = sizeof(stdlib_pow2_code),
+    .symbols    = stdlib_pow2_symbols,
+    .symbol_cnt = sizeof(stdlib_pow2_symbols)
+                / sizeof(*stdlib_pow2_symbols)
+};
+
+// stdlib_double.asm
+static constexpr unsigned char stdlib_double_code[] = {
+    0x55, 0x48, 0x89, 0xE5, 0x48, 0x83, 0xEC, 0x20, 0xF2, 0x0F, 0x10, 0x45,
+    0x10, 0xB8, 0xE8, 0x03, 0x00, 0x00, 0xF2, 0x48, 0x0F, 0x2A, 0xC8, 0xF2,
+    0x0F, 0x59, 0xC1, 0xF2, 0x48, 0x0F, 0x2D, 0xC0, 0x4D, 0x31, 0xC0, 0x48,
+    0x85, 0xC0, 0x7D, 0x06, 0x48, 0xF7, 0xD8, 0x49, 0xFF, 0xC0, 0x4C, 0x8D,
+    0x0D, 0x37, 0x01, 0x00, 0x00, 0x48, 0x8D, 0x7D, 0xFF, 0xC6, 0x07, 0x0A,
+    0x48, 0x89, 0xC6, 0x48, 0xC1, 0xE8, 0x03, 0x48, 0xBA, 0xCF, 0xF7, 0x53,
+    0xE3, 0xA5, 0x9B, 0xC4, 0x20, 0x48, 0xF7, 0xE2, 0x48, 0xC1, 0xEA, 0x04,
+    0x48, 0x69, 0xC2, 0xE8, 0x03, 0x00, 0x00, 0x48, 0x29, 0xC6, 0x48, 0x89,
+    0xD0, 0x6B, 0xCE, 0x29, 0xC1, 0xE9, 0x0C, 0x6B, 0xD1, 0x64, 0x29, 0xD6,
+    0x41, 0x0F, 0xB7, 0x14, 0x71, 0x48, 0x83, 0xEF, 0x02, 0x66, 0x89, 0x17,
+    0x80, 0xC1, 0x30, 0x48, 0xFF, 0xCF, 0x88, 0x0F, 0x48, 0xFF, 0xCF, 0xC6,
+    0x07, 0x2E, 0x48, 0x83, 0xF8, 0x64, 0x72, 0x30, 0x48, 0x89, 0xC6, 0x48,
+    0xC1, 0xE8, 0x02, 0x48, 0xBA, 0xC3, 0xF5, 0x28, 0x5C, 0x8F, 0xC2, 0xF5,
+    0x28, 0x48, 0xF7, 0xE2, 0x48, 0xC1, 0xEA, 0x02, 0x48, 0x6B, 0xC2, 0x64,
+    0x48, 0x29, 0xC6, 0x48, 0x89, 0xD0, 0x41, 0x0F, 0xB7, 0x14, 0x71, 0x48,
+    0x83, 0xEF, 0x02, 0x66, 0x89, 0x17, 0xEB, 0xCA, 0x48, 0x83, 0xF8, 0x0A,
+    0x72, 0x0E, 0x41, 0x0F, 0xB7, 0x14, 0x41, 0x48, 0x83, 0xEF, 0x02, 0x66,
+    0x89, 0x17, 0xEB, 0x07, 0x04, 0x30, 0x48, 0xFF, 0xCF, 0x88, 0x07, 0x4D,
+    0x85, 0xC0, 0x74, 0x06, 0x48, 0xFF, 0xCF, 0xC6, 0x07, 0x2D, 0x48, 0x89,
+    0xE9, 0x48, 0x29, 0xF9, 0x48, 0x8B, 0x14, 0x25, 0x00, 0xF0, 0x5D, 0x00,
+    0x48, 0x8D, 0x04, 0x0A, 0x48, 0x3D, 0x00, 0x00, 0x01, 0x00, 0x76, 0x0A,
+    0x51, 0xE8, 0x2E, 0x00, 0x00, 0x00, 0x59, 0x48, 0x31, 0xD2, 0x48, 0x8D,
+    0xBA, 0x00, 0x00, 0x5F, 0x00, 0x48, 0x89, 0xEE, 0x48, 0x29, 0xCE, 0x48,
+    0x01, 0xCA, 0x48, 0x89, 0x14, 0x25, 0x00, 0xF0, 0x5D, 0x00, 0xF3, 0xA4,
+    0x48, 0x83, 0xC4, 0x20, 0x5D, 0x80, 0x3C, 0x25, 0x08, 0xF0, 0x5D, 0x00,
+    0x00, 0x75, 0x01, 0xC3, 0x48, 0xC7, 0xC6, 0x00, 0x00, 0x5F, 0x00, 0x48,
+    0x8B, 0x14, 0x25, 0x00, 0xF0, 0x5D, 0x00, 0x48, 0x85, 0xD2, 0x7E, 0x1B,
+    0xBF, 0x01, 0x00, 0x00, 0x00, 0x48, 0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00,
+    0x0F, 0x05, 0x48, 0x85, 0xC0, 0x7E, 0x08, 0x48, 0x01, 0xC6, 0x48, 0x29,
+    0xC2, 0xEB, 0xE0, 0x48, 0xC7, 0x04, 0x25, 0x00, 0xF0, 0x5D, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xC3, 0x30, 0x30, 0x30, 0x31, 0x30, 0x32, 0x30, 0x33,
+    0x30, 0x34, 0x30, 0x35, 0x30, 0x36, 0x30, 0x37, 0x30, 0x38, 0x30, 0x39,
+    0x31, 0x30, 0x31, 0x31, 0x31, 0x32, 0x31, 0x33, 0x31, 0x34, 0x31, 0x35,
+    0x31, 0x36, 0x31, 0x37, 0x31, 0x38, 0x31, 0x39, 0x32, 0x30, 0x32, 0x31,
+    0x32, 0x32, 0x32, 0x33, 0x32, 0x34, 0x32, 0x35, 0x32, 0x36, 0x32, 0x37,
+    0x32, 0x38, 0x32, 0x39, 0x33, 0x30, 0x33, 0x31, 0x33, 0x32, 0x33, 0x33,
+    0x33, 0x34, 0x33, 0x35, 0x33, 0x36, 0x33, 0x37, 0x33, 0x38, 0x33, 0x39,
+    0x34, 0x30, 0x34, 0x31, 0x34, 0x32, 0x34, 0x33, 0x34, 0x34, 0x34, 0x35,
+    0x34, 0x36, 0x34, 0x37, 0x34, 0x38, 0x34, 0x39, 0x35, 0x30, 0x35, 0x31,
+    0x35, 0x32, 0x35, 0x33, 0x35, 0x34, 0x35, 0x35, 0x35, 0x36, 0x35, 0x37,
+    0x35, 0x38, 0x35, 0x39, 0x36, 0x30, 0x36, 0x31, 0x36, 0x32, 0x36, 0x33,
+    0x36, 0x34, 0x36, 0x35, 0x36, 0x36, 0x36, 0x37, 0x36, 0x38, 0x36, 0x39,
+    0x37, 0x30, 0x37, 0x31, 0x37, 0x32, 0x37, 0x33, 0x37, 0x34, 0x37, 0x35,
+    0x37, 0x36, 0x37, 0x37, 0x37, 0x38, 0x37, 0x39, 0x38, 0x30, 0x38, 0x31,
+    0x38, 0x32, 0x38, 0x33, 0x38, 0x34, 0x38, 0x35, 0x38, 0x36, 0x38, 0x37,
+    0x38, 0x38, 0x38, 0x39, 0x39, 0x30, 0x39, 0x31, 0x39, 0x32, 0x39, 0x33,
+    0x39, 0x34, 0x39, 0x35, 0x39, 0x36, 0x39, 0x37, 0x39, 0x38, 0x39, 0x39,
+    0x55, 0x48, 0x89, 0xE5, 0x48, 0x8B, 0x34, 0x25, 0x10, 0xF0, 0x5D, 0x00,
+    0x4C, 0x8B, 0x04, 0x25, 0x18, 0xF0, 0x5D, 0x00, 0x4D, 0x31, 0xC9, 0x49,
+    0xC7, 0xC2, 0x01, 0x00, 0x00, 0x00, 0xE8, 0xA7, 0x00, 0x00, 0x00, 0x48,
+    0x83, 0xFA, 0x20, 0x77, 0x05, 0x48, 0xFF, 0xC6, 0xEB, 0xF0, 0x48, 0x83,
+    0xFA, 0x2D, 0x75, 0x06, 0x49, 0xF7, 0xDA, 0x48, 0xFF, 0xC6, 0xE8, 0x8B,
+    0x00, 0x00, 0x00, 0x48, 0x83, 0xEA, 0x30, 0x48, 0x83, 0xFA, 0x09, 0x77,
+    0x0C, 0x4D, 0x6B, 0xC9, 0x0A, 0x49, 0x01, 0xD1, 0x48, 0xFF, 0xC6, 0xEB,
+    0xE5, 0x48, 0x83, 0xFA, 0xFE, 0x75, 0x3B, 0x48, 0xFF, 0xC6, 0x49, 0xC7,
+    0xC7, 0x03, 0x00, 0x00, 0x00, 0xE8, 0x60, 0x00, 0x00, 0x00, 0x48, 0x83,
+    0xEA, 0x30, 0x48, 0x83, 0xFA, 0x09, 0x77, 0x14, 0x48, 0xFF, 0xC6, 0x4D,
+    0x85, 0xFF, 0x74, 0xE9, 0x4D, 0x6B, 0xC9, 0x0A, 0x49, 0x01, 0xD1, 0x49,
+    0xFF, 0xCF, 0xEB, 0xDD, 0x4D, 0x85, 0xFF, 0x74, 0x09, 0x4D, 0x6B, 0xC9,
+    0x0A, 0x49, 0xFF, 0xCF, 0xEB, 0xF2, 0x48, 0x89, 0x34, 0x25, 0x10, 0xF0,
+    0x5D, 0x00, 0x4C, 0x89, 0x04, 0x25, 0x18, 0xF0, 0x5D, 0x00, 0x4C, 0x89,
+    0xC8, 0x4C, 0x89, 0xD7, 0x48, 0x0F, 0xAF, 0xC7, 0xF2, 0x48, 0x0F, 0x2A,
+    0xC0, 0xB8, 0xE8, 0x03, 0x00, 0x00, 0xF2, 0x48, 0x0F, 0x2A, 0xC8, 0xF2,
+    0x0F, 0x5E, 0xC1, 0x66, 0x48, 0x0F, 0x7E, 0xC0, 0x5D, 0xC3, 0x4C, 0x39,
+    0xC6, 0x72, 0x35, 0x48, 0x31, 0xFF, 0x48, 0xC7, 0xC6, 0x00, 0x00, 0x5E,
+    0x00, 0x48, 0xC7, 0xC2, 0x00, 0x00, 0x01, 0x00, 0x48, 0x31, 0xC0, 0x0F,
+    0x05, 0x48, 0xC7, 0xC6, 0x00, 0x00, 0x5E, 0x00, 0x48, 0x85, 0xC0, 0x7F,
+    0x03, 0x48, 0x31, 0xC0, 0x4C, 0x8D, 0x04, 0x06, 0x48, 0xC7, 0xC2, 0xFF,
+    0xFF, 0xFF, 0xFF, 0x48, 0x85, 0xC0, 0x74, 0x03, 0x0F, 0xB6, 0x16, 0xC3,
+    0x55, 0x48, 0x89, 0xE5, 0xF2, 0x0F, 0x51, 0x45, 0x10, 0x66, 0x48, 0x0F,
+    0x7E, 0xC0, 0x5D, 0xC3,
+};
+
+static constexpr stdlib_symbol stdlib_double_symbols[] = {
+    { "print_num",           0x000 },
+    { "print_flush",         0x130 },
+    { "digit_pairs",         0x16C },
+    { "read_num",            0x234 },
+    { "read_peek",           0x2FE },
+    { "sqrt",                0x33C },
+    { "stdlib_end",          0x34C },
+};
+
+static constexpr stdlib_image stdlib_double = {
+    .code       = stdlib_double_code,
+    .size       = sizeof(stdlib_double_code),
+    .symbols    = stdlib_double_symbols,
+    .symbol_cnt = sizeof(stdlib_double_symbols)
+                / sizeof(*stdlib_double_symbols)
+};
+
+#endif /* stdlib_image.h */
@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast_dsl.h"
+#include "ast_utils.h"
+
+size_t count_nodes(const ast_node* node)
+{
+    if (!node) return 0;
+    return 1 + count_nodes(node->left) + count_nodes(node->right);
+}
+
+size_t count_ops(const ast_node* node)
+{
+    if (!node) return 0;
+    return (node->type == NODE_OP) + count_ops(node->left)
+                                   + count_ops(node->right);
+}
+
+bool contains_type(const ast_node* node, node_type type)
+{
+    if (!node) return false;
+    if (node->type == type) return true;
+    return contains_type(node->left, type) || contains_type(node->right, type);
+}
+
+bool contains_name(const ast_node* node, node_type type, const char* name)
+{
+    if (!node) return false;
+    if (node->type == type && strcmp(node->value.name, name) == 0)
+        return true;
+    return contains_name(node->left,  type, name)
+        || contains_name(node->right, type, name);
+}
+
+bool is_same_expr(const ast_node* first, const ast_node* second)
+{
+    if (!first || !second)
+        return first == second;
+    if (first->type != second->type)
+        return false;
+
+    switch (first->type)
+    {
+    case NODE_VAR:
+        return strcmp(first->value.name, second->value.name) == 0;
+    case NODE_CONST:
+        return memcmp(&first->value.num, &second->value.num,
+                      sizeof(first->value.num)) == 0;
+    case NODE_OP:
+        return first->value.op == second->value.op
+            && is_same_expr(first->left,  second->left)
+            && is_same_expr(first->right, second->right);
+
+    case NODE_DEFS: case NODE_NVAR: case NODE_NFUN: case NODE_ARG:
+    case NODE_BLOCK: case NODE_SEQ: case NODE_ASS: case NODE_IF:
+    case NODE_BRANCH: case NODE_WHILE: case NODE_RET: case NODE_CALL:
+    case NODE_PAR: case NODE_CMP: case NODE_LOGIC:
+    default:
+        return false;
+    }
+}
+
+bool is_integer_const(const ast_node* node)
+{
+    return is_num(node) && num_cmp(node, round(get_num(node)));
+}
+
+bool is_global_var(const ast_node* defs, const char* name)
+{
+    for (const ast_node* def = defs; def; def = def->right)
+    {
+        if (def->left && def->left->type == NODE_NVAR &&
+                strcmp(def->left->value.name, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool calls_program_function(const ast_node* node, const ast_node* defs)
+{
+    if (!node) return false;
+    if (node->type == NODE_CALL)
+    {
+        for (const ast_node* def = defs; def; def = def->right)
+            if (def->left && def->left->type == NODE_NFUN &&
+                    strcmp(def->left->value.name, node->value.name) == 0)
+                return true;
+    }
+    return calls_program_function(node->left,  defs)
+        || calls_program_function(node->right, defs);
+}
+
+char* make_var_name(const char* prefix, size_t id)
+{
+    size_t size = (size_t) snprintf(NULL, 0, "__%s%zu", prefix, id) + 1;
+    char* result = (char*) calloc(size, sizeof(*result));
+    snprintf(result, size, "__%s%zu", prefix, id);
+    return result;
+}
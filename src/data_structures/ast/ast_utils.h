@@ -0,0 +1,66 @@
+/**
+ * @file ast_utils.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief Queries over syntax tree shared by mid-end passes
+ *
+ * @version 0.1
+ * @date 2023-06-05
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef AST_UTILS_H
+#define AST_UTILS_H
+
+#include "ast.h"
+
+/**
+ * @brief Count nodes in subtree
+ */
+size_t count_nodes(const ast_node* node);
+
+/**
+ * @brief Count `NODE_OP` nodes in subtree
+ */
+size_t count_ops(const ast_node* node);
+
+/**
+ * @brief Check whether subtree contains node of given type
+ */
+bool contains_type(const ast_node* node, node_type type);
+
+/**
+ * @brief Check whether subtree contains node of given type with given name
+ */
+bool contains_name(const ast_node* node, node_type type, const char* name);
+
+/**
+ * @brief Check whether two expressions built from variables, constants and
+ * operations are identical
+ */
+bool is_same_expr(const ast_node* first, const ast_node* second);
+
+/**
+ * @brief Check whether node is a constant with integer value
+ */
+bool is_integer_const(const ast_node* node);
+
+/**
+ * @brief Check whether `name` is declared as global variable in program
+ * definitions list `defs`
+ */
+bool is_global_var(const ast_node* defs, const char* name);
+
+/**
+ * @brief Check whether subtree calls any function defined in program
+ * definitions list `defs`
+ */
+bool calls_program_function(const ast_node* node, const ast_node* defs);
+
+/**
+ * @brief Create name `__<prefix><id>` for variable introduced by compiler.
+ * Returned string must be freed by caller.
+ */
+char* make_var_name(const char* prefix, size_t id);
+
+#endif
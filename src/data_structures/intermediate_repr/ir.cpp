@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "ir.h"
 
 #define ARRAY_ELEMENT ir_node_ptr
@@ -41,14 +43,17 @@ void ir_list_dump(ir_node* head, FILE* output)
     fputs("]\n", output);
 }
 
-void ir_list_write(const ir_node* head, FILE* output)
+size_t ir_list_write(const ir_node* head, unsigned char* output)
 {
+    size_t written = 0;
     const ir_node* current = head;
     while (current)
     {
-        fwrite(current->bytes, sizeof(char), current->encoded_length, output);
+        memcpy(output + written, current->bytes, current->encoded_length);
+        written += current->encoded_length;
         current = current->next;
     }
+    return written;
 }
 
 void ir_list_clear(ir_node* head)
@@ -58,8 +63,67 @@ void ir_list_clear(ir_node* head)
     {
         ir_node* tmp = current;
         current = current->next;
-        free(tmp);
+        ir_node_free(tmp);
+    }
+}
+
+struct ir_arena_chunk
+{
+    ir_arena_chunk* prev;
+    ir_node         nodes[IR_ARENA_CHUNK_SIZE];
+};
+
+static ir_arena* selected_arena = NULL;
+
+void ir_arena_ctor(ir_arena* arena)
+{
+    arena->last_chunk = NULL;
+    arena->used       = 0;
+}
+
+void ir_arena_dtor(ir_arena* arena)
+{
+    ir_arena_chunk* chunk = arena->last_chunk;
+    while (chunk)
+    {
+        ir_arena_chunk* prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+    if (selected_arena == arena)
+        selected_arena = NULL;
+    arena->last_chunk = NULL;
+    arena->used       = 0;
+}
+
+void ir_arena_select(ir_arena* arena)
+{
+    selected_arena = arena;
+}
+
+ir_node* ir_node_alloc(void)
+{
+    ir_arena* arena = selected_arena;
+    if (!arena)
+        return (ir_node*) calloc(1, sizeof(ir_node));
+
+    if (!arena->last_chunk || arena->used == IR_ARENA_CHUNK_SIZE)
+    {
+        ir_arena_chunk* chunk =
+                    (ir_arena_chunk*) calloc(1, sizeof(ir_arena_chunk));
+        if (!chunk)
+            return NULL;
+        chunk->prev       = arena->last_chunk;
+        arena->last_chunk = chunk;
+        arena->used       = 0;
     }
+    return &arena->last_chunk->nodes[arena->used++];
+}
+
+void ir_node_free(ir_node* node)
+{
+    if (!selected_arena)
+        free(node);
 }
 
 
@@ -114,8 +178,11 @@ static void ir_op_dump(ir_op operation, FILE* output)
     switch (operation)
     {
     case IR_NOP:  fputs("\"NOP\"",  output); break;
+    case IR_ALIGN: fputs("\"ALIGN\"", output); break;
     case IR_MOV:  fputs("\"MOV\"",  output); break;
     case IR_CMOV: fputs("\"CMOV\"", output); break;
+    case IR_MOVZX: fputs("\"MOVZX\"", output); break;
+    case IR_SETCC: fputs("\"SETCC\"", output); break;
     case IR_PUSH: fputs("\"PUSH\"", output); break;
     case IR_POP:  fputs("\"POP\"",  output); break;
 
@@ -124,6 +191,12 @@ static void ir_op_dump(ir_op operation, FILE* output)
     case IR_MUL: fputs("\"MUL\"", output); break;
     case IR_DIV: fputs("\"DIV\"", output); break;
     case IR_NEG: fputs("\"NEG\"", output); break;
+    case IR_MULH: fputs("\"MULH\"", output); break;
+    case IR_LEA: fputs("\"LEA\"", output); break;
+
+    case IR_SHL: fputs("\"SHL\"", output); break;
+    case IR_SHR: fputs("\"SHR\"", output); break;
+    case IR_SAR: fputs("\"SAR\"", output); break;
 
     case IR_AND: fputs("\"AND\"", output); break;
     case IR_OR:  fputs("\"OR\"",  output); break;
@@ -138,6 +211,18 @@ static void ir_op_dump(ir_op operation, FILE* output)
     case IR_RET:     fputs("\"RET\"",     output); break;
     case IR_SYSCALL: fputs("\"SYSCALL\"", output); break;
 
+    case IR_MOVSD:     fputs("\"MOVSD\"",     output); break;
+    case IR_MOVQ:      fputs("\"MOVQ\"",      output); break;
+    case IR_ADDSD:     fputs("\"ADDSD\"",     output); break;
+    case IR_SUBSD:     fputs("\"SUBSD\"",     output); break;
+    case IR_MULSD:     fputs("\"MULSD\"",     output); break;
+    case IR_DIVSD:     fputs("\"DIVSD\"",     output); break;
+    case IR_SQRTSD:    fputs("\"SQRTSD\"",    output); break;
+    case IR_UCOMISD:   fputs("\"UCOMISD\"",   output); break;
+    case IR_CVTSI2SD:  fputs("\"CVTSI2SD\"",  output); break;
+    case IR_CVTTSD2SI: fputs("\"CVTTSD2SI\"", output); break;
+    case IR_CVTSD2SI: fputs("\"CVTSD2SI\"", output); break;
+
     default:
         fputs("\"UNKNOWN\"", output);
         break;
@@ -195,6 +280,13 @@ static void ir_register_dump(ir_reg reg, FILE* output)
     case IR_REG_R14: fputs("\"R14\"", output); break;
     case IR_REG_R15: fputs("\"R15\"", output); break;
 
+    case IR_REG_XMM0:  case IR_REG_XMM1:  case IR_REG_XMM2:  case IR_REG_XMM3:
+    case IR_REG_XMM4:  case IR_REG_XMM5:  case IR_REG_XMM6:  case IR_REG_XMM7:
+    case IR_REG_XMM8:  case IR_REG_XMM9:  case IR_REG_XMM10: case IR_REG_XMM11:
+    case IR_REG_XMM12: case IR_REG_XMM13: case IR_REG_XMM14: case IR_REG_XMM15:
+        fprintf(output, "\"XMM%d\"", (int) reg - (int) IR_REG_XMM0);
+        break;
+
     default:
         fputs("\"UNKNOWN\"", output);
         break;
@@ -216,6 +308,12 @@ static void ir_cond_dump(ir_cond_flags cond, FILE* output)
     case IR_COND_EQUAL:         fputs("\"EQUAL\"",          output); break;
     case IR_COND_NOT_EQUAL:     fputs("\"NOT_EQUAL\"",      output); break;
 
+    case IR_COND_ABOVE:         fputs("\"ABOVE\"",          output); break;
+    case IR_COND_NOT_ABOVE:     fputs("\"NOT_ABOVE\"",      output); break;
+
+    case IR_COND_BELOW:         fputs("\"BELOW\"",          output); break;
+    case IR_COND_NOT_BELOW:     fputs("\"NOT_BELOW\"",      output); break;
+
     default:
         fputs("\"UNKNOWN\"", output);
         break;
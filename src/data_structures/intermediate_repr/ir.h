@@ -19,13 +19,19 @@
 enum ir_op
 {
     IR_NOP = 0,
+    IR_ALIGN,       // Padding to multiple of `operand1.immediate` bytes
 
     IR_MOV,  IR_CMOV,
+    IR_MOVZX, IR_SETCC,
     IR_PUSH, IR_POP,
 
     IR_ADD,  IR_SUB,
     IR_MUL,  IR_DIV,
-    IR_NEG,
+    IR_NEG,  IR_MULH,
+    IR_LEA,
+
+    IR_SHL,  IR_SHR,
+    IR_SAR,
 
     IR_AND,  IR_OR,
     IR_XOR,  IR_NOT,
@@ -34,7 +40,14 @@ enum ir_op
     IR_JMP,
 
     IR_CALL, IR_RET,
-    IR_SYSCALL
+    IR_SYSCALL,
+
+    IR_MOVSD,  IR_MOVQ,
+    IR_ADDSD,  IR_SUBSD,
+    IR_MULSD,  IR_DIVSD,
+    IR_SQRTSD, IR_UCOMISD,
+    IR_CVTSI2SD, IR_CVTTSD2SI,
+    IR_CVTSD2SI     // Rounds to nearest, unlike IR_CVTTSD2SI
 };
 
 enum ir_cond_flags
@@ -42,7 +55,9 @@ enum ir_cond_flags
     IR_COND_NONE = 0,
     IR_COND_GREATER, IR_COND_NOT_GREATER,
     IR_COND_LESS,    IR_COND_NOT_LESS,
-    IR_COND_EQUAL,   IR_COND_NOT_EQUAL
+    IR_COND_EQUAL,   IR_COND_NOT_EQUAL,
+    IR_COND_ABOVE,   IR_COND_NOT_ABOVE,     // Unsigned and floating-point
+    IR_COND_BELOW,   IR_COND_NOT_BELOW      // comparisons
 };
 
 enum ir_reg
@@ -51,7 +66,12 @@ enum ir_reg
     IR_REG_RAX, IR_REG_RBX, IR_REG_RCX, IR_REG_RDX,
     IR_REG_RSI, IR_REG_RDI, IR_REG_RSP, IR_REG_RBP,
     IR_REG_R8,  IR_REG_R9,  IR_REG_R10, IR_REG_R11,
-    IR_REG_R12, IR_REG_R13, IR_REG_R14, IR_REG_R15
+    IR_REG_R12, IR_REG_R13, IR_REG_R14, IR_REG_R15,
+
+    IR_REG_XMM0,  IR_REG_XMM1,  IR_REG_XMM2,  IR_REG_XMM3,
+    IR_REG_XMM4,  IR_REG_XMM5,  IR_REG_XMM6,  IR_REG_XMM7,
+    IR_REG_XMM8,  IR_REG_XMM9,  IR_REG_XMM10, IR_REG_XMM11,
+    IR_REG_XMM12, IR_REG_XMM13, IR_REG_XMM14, IR_REG_XMM15
 };
 
 enum ir_operand_flags
@@ -75,22 +95,82 @@ typedef ir_node* ir_node_ptr;
 
 struct ir_node
 {
-    size_t          node_id;
-    bool is_valid;
-
+    /* Fields used during code generation and optimization come first, so
+     * that they share cache line */
+    ir_node_ptr     next;
+    ir_node_ptr     jump_target;
     ir_op           operation;
+    ir_cond_flags   flags;
     ir_operand      operand1,
                     operand2;
-    ir_cond_flags   flags;
-    ir_node_ptr     jump_target;
-    size_t          addr;
+    bool            is_valid;
 
+    /* Fields used only during encoding and output */
+    size_t          node_id;
+    size_t          addr;
     size_t          encoded_length;
     unsigned char   bytes[16];
+};
 
-    ir_node_ptr     next;
+/**
+ * @brief Number of IR nodes in single arena chunk
+ */
+const size_t IR_ARENA_CHUNK_SIZE = 4096;
+
+struct ir_arena_chunk;
+
+/**
+ * @brief Storage for IR nodes. Nodes are placed contiguously in order of
+ * allocation and are released all at once.
+ */
+struct ir_arena
+{
+    ir_arena_chunk* last_chunk;     // Most recently allocated chunk
+    size_t          used;           // Number of nodes taken from last chunk
 };
 
+/**
+ * @brief Create empty arena
+ *
+ * @param[out] arena    Constructed arena
+ *
+ */
+void ir_arena_ctor(ir_arena* arena);
+
+/**
+ * @brief Release all nodes allocated in arena
+ *
+ * @param[inout] arena  Destroyed arena
+ *
+ */
+void ir_arena_dtor(ir_arena* arena);
+
+/**
+ * @brief Set arena used by `ir_node_alloc()`. Nodes are allocated on heap
+ * if no arena is selected.
+ *
+ * @param[in] arena     Selected arena (can be `NULL`)
+ *
+ */
+void ir_arena_select(ir_arena* arena);
+
+/**
+ * @brief Allocate zero-initialized IR node in selected arena
+ *
+ * @return Allocated node
+ */
+ir_node* ir_node_alloc(void);
+
+/**
+ * @brief Free IR node allocated by `ir_node_alloc()`. Nodes allocated in
+ * arena are released only together with arena, so this must be called
+ * with the same arena selected.
+ *
+ * @param[inout] node   Freed node
+ *
+ */
+void ir_node_free(ir_node* node);
+
 /**
  * @brief Print verbose information about IR to specified file
  *
@@ -101,16 +181,17 @@ struct ir_node
 void ir_list_dump(ir_node* head, FILE* output);
 
 /**
- * @brief Write compiled IR to file
+ * @brief Copy compiled IR to memory
  *
- * @param[in] head      Start of IR linked list
- * @param[in] output    Output stream (in binary mode)
+ * @param[in]  head     Start of IR linked list
+ * @param[out] output   Destination buffer
  *
+ * @return Number of bytes written
  */
-void ir_list_write(const ir_node* head, FILE* output);
+size_t ir_list_write(const ir_node* head, unsigned char* output);
 
 /**
- * @brief Free all nodes in a linked list of IR nodes
+ * @brief Free all nodes in a linked list of IR nodes (see `ir_node_free()`)
  *
  * @param[in] head      Start of IR linked list
  *
@@ -22,7 +22,7 @@
 
 inline ir_node* ir_node_new_empty(void)
 {
-    return (ir_node*) calloc(1, sizeof(ir_node));
+    return ir_node_alloc();
 }
 
 inline ir_node* ir_node_new_call(ir_node_ptr function)
@@ -34,6 +34,15 @@ inline ir_node* ir_node_new_call(ir_node_ptr function)
     return node;
 }
 
+inline ir_node* ir_node_new_jmp(ir_node_ptr target)
+{
+    ir_node* node = ir_node_new_empty();
+    node->is_valid = true;
+    node->operation = IR_JMP;
+    node->jump_target = target;
+    return node;
+}
+
 inline ir_node* ir_node_new_ret(void)
 {
     ir_node* node = ir_node_new_empty();
@@ -88,5 +97,14 @@ inline ir_node* ir_node_new_pop_reg(ir_reg reg)
     return node;
 }
 
+inline ir_node* ir_node_new_align(long alignment)
+{
+    ir_node* node = ir_node_new_empty();
+    node->is_valid = true;
+    node->operation = IR_ALIGN;
+    node->operand1 = ir_operand_imm(alignment);
+    return node;
+}
+
 
 #endif /* ir_dsl.h */
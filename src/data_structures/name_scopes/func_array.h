@@ -10,6 +10,7 @@ struct function
     ir_node*        ir_list_head;
     const char*     name;
     size_t          arg_cnt;
+    bool            is_used;
 };
 
 #define ARRAY_ELEMENT function
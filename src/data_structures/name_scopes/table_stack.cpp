@@ -25,7 +25,7 @@ void table_stack_ctor(table_stack *tb_stack)
 
     var_table global = {};
     // TODO: Extract
-    var_table_ctor(&global, 0x401000, true);
+    var_table_ctor(&global, 0x600000, true);
 
     array_push(&tb_stack->tables, global);
 }
@@ -0,0 +1,531 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/logger/logger.h"
+#include "data_structures/ast/ast_utils.h"
+
+#include "inliner.h"
+
+/* Functions with larger bodies are not inlined */
+static const size_t INLINE_MAX_SIZE = 64;
+
+struct inline_state
+{
+    ast_node* defs;         // Program definitions
+    ast_node* caller;       // Function, which is currently processed
+    size_t    inline_cnt;   // Number of inlined calls, used in variable names
+};
+
+/**
+ * @brief Variable of inlined function, visible at current point
+ */
+struct rename_entry
+{
+    const char*         name;
+    const ast_node*     value;  // `NVAR` with new name or `CONST` to substitute
+    const rename_entry* next;
+};
+
+/**
+ * @brief Control flow of statement with respect to `riturn`
+ */
+enum return_kind
+{
+    RETURNS_NEVER,
+    RETURNS_ALWAYS,
+    RETURNS_SOMETIMES,      // All returns are in tail position
+    RETURNS_UNSUPPORTED     // Return cannot be replaced by assignment
+};
+
+static void inline_in_stmt(ast_node* stmt, inline_state* state);
+
+/* Parent pointers are not kept by tree reader and simplifier */
+static void restore_parents(ast_node* node)
+{
+    if (node->left)
+    {
+        node->left->parent = node;
+        restore_parents(node->left);
+    }
+    if (node->right)
+    {
+        node->right->parent = node;
+        restore_parents(node->right);
+    }
+}
+
+bool inline_functions(abstract_syntax_tree* tree)
+{
+    LOG_ASSERT(tree != NULL, return false);
+    LOG_ASSERT(tree->root != NULL, return false);
+
+    tree->root->parent = NULL;
+    restore_parents(tree->root);
+
+    inline_state state = { .defs = tree->root, .caller = NULL, .inline_cnt = 0 };
+
+    for (ast_node* def = tree->root; def; def = def->right)
+    {
+        LOG_ASSERT(def->type == NODE_DEFS, return false);
+        if (!def->left || def->left->type != NODE_NFUN)
+            continue;
+
+        state.caller = def->left;
+        inline_in_stmt(def->left->right, &state);
+    }
+
+    return true;
+}
+
+static bool declares_name(const ast_node* node, const char* name)
+{
+    return contains_name(node, NODE_NVAR, name)
+        || contains_name(node, NODE_ARG,  name);
+}
+
+static ast_node* find_function(const inline_state* state, const char* name)
+{
+    for (ast_node* def = state->defs; def; def = def->right)
+    {
+        if (def->left && def->left->type == NODE_NFUN &&
+                strcmp(def->left->value.name, name) == 0)
+            return def->left;
+    }
+    return NULL;
+}
+
+static bool is_inlinable(const ast_node* callee, const inline_state* state)
+{
+    if (!callee || callee == state->caller)
+        return false;
+
+    return count_nodes(callee->right) <= INLINE_MAX_SIZE
+        && !contains_name(callee->right, NODE_CALL, callee->value.name);
+}
+
+/* Check whether function has `riturn` directly in its body */
+static bool has_top_level_return(const ast_node* func)
+{
+    for (const ast_node* seq = func->right->right; seq; seq = seq->right)
+        if (seq->left && seq->left->type == NODE_RET)
+            return true;
+    return false;
+}
+
+/* Count calls in expression and find the first one with no calls in arguments */
+static size_t find_innermost_call(ast_node* node, ast_node** innermost)
+{
+    if (!node) return 0;
+
+    size_t calls = find_innermost_call(node->left,  innermost)
+                 + find_innermost_call(node->right, innermost);
+    if (node->type != NODE_CALL)
+        return calls;
+
+    if (calls == 0 && *innermost == NULL)
+        *innermost = node;
+    return calls + 1;
+}
+
+static char* make_local_name(size_t id, const char* name)
+{
+    size_t size = (size_t) snprintf(NULL, 0, "__inl%zu_%s", id, name) + 1;
+    char* result = (char*) calloc(size, sizeof(*result));
+    snprintf(result, size, "__inl%zu_%s", id, name);
+    return result;
+}
+
+static const rename_entry* find_entry(const rename_entry* scope,
+                                      const char* name)
+{
+    for (; scope; scope = scope->next)
+        if (strcmp(scope->name, name) == 0)
+            return scope;
+    return NULL;
+}
+
+/**
+ * @brief Give unique names to variables of inlined function and substitute
+ * constant arguments. Fails, if inlined function references global
+ * variable, which is shadowed at call site.
+ */
+static bool rename_locals(ast_node* node, const rename_entry* scope,
+                          size_t id, const inline_state* state)
+{
+    if (!node) return true;
+
+    if (node->type == NODE_SEQ && node->left && node->left->type == NODE_NVAR)
+    {
+        ast_node* decl = node->left;
+        if (!rename_locals(decl->right, scope, id, state))
+            return false;
+
+        char* old_name = decl->value.name;
+        decl->value.name = make_local_name(id, old_name);
+
+        rename_entry entry = { .name = old_name, .value = decl, .next = scope };
+        bool result = rename_locals(node->right, &entry, id, state);
+        free(old_name);
+        return result;
+    }
+
+    if (node->type == NODE_NVAR)    // Declaration outside of sequence
+        return false;
+
+    if (node->type != NODE_VAR && node->type != NODE_ASS)
+        return rename_locals(node->left,  scope, id, state)
+            && rename_locals(node->right, scope, id, state);
+
+    const rename_entry* entry = find_entry(scope, node->value.name);
+    if (!entry)                     // Global variable
+    {
+        if (declares_name(state->caller, node->value.name))
+            return false;
+        return rename_locals(node->right, scope, id, state);
+    }
+
+    free(node->value.name);
+    if (entry->value->type == NODE_CONST)
+    {
+        LOG_ASSERT(node->type == NODE_VAR, return false);
+        node->type  = NODE_CONST;
+        node->value = entry->value->value;
+        return true;
+    }
+    node->value.name = strdup(entry->value->value.name);
+    return rename_locals(node->right, scope, id, state);
+}
+
+static return_kind lower_returns(ast_node* stmt, const char* ret_name);
+
+static return_kind lower_if_returns(ast_node* stmt, const char* ret_name,
+                                    return_kind* pos, return_kind* neg)
+{
+    ast_node* branch = stmt->right;
+    *pos = lower_returns(branch->left, ret_name);
+    *neg = branch->right ? lower_returns(branch->right, ret_name)
+                         : RETURNS_NEVER;
+
+    if (*pos == RETURNS_UNSUPPORTED || *neg == RETURNS_UNSUPPORTED)
+        return RETURNS_UNSUPPORTED;
+    if (*pos == *neg)
+        return *pos;
+    return RETURNS_SOMETIMES;
+}
+
+/**
+ * @brief Replace returns in statement sequence with assignments. Statements
+ * following conditional return are moved to the branch, which does not
+ * return, so that every return ends up in tail position.
+ */
+static return_kind lower_seq_returns(ast_node* seq, const char* ret_name)
+{
+    for (ast_node* cur = seq; cur; cur = cur->right)
+    {
+        ast_node* stmt = cur->left;
+        return_kind pos = RETURNS_NEVER;
+        return_kind neg = RETURNS_NEVER;
+        return_kind kind = stmt->type == NODE_IF
+                                ? lower_if_returns(stmt, ret_name, &pos, &neg)
+                                : lower_returns(stmt, ret_name);
+        switch (kind)
+        {
+        case RETURNS_NEVER:
+            break;
+
+        case RETURNS_ALWAYS:        // Following statements are unreachable
+            if (cur->right)
+                delete_subtree(cur->right);
+            cur->right = NULL;
+            return RETURNS_ALWAYS;
+
+        case RETURNS_SOMETIMES:
+        {
+            if (!cur->right)
+                return RETURNS_SOMETIMES;
+            // Rest is moved to the other branch only if taking returning
+            // branch always returns
+            if (stmt->type != NODE_IF
+                || !((pos == RETURNS_ALWAYS && neg == RETURNS_NEVER)
+                  || (pos == RETURNS_NEVER  && neg == RETURNS_ALWAYS)))
+                return RETURNS_UNSUPPORTED;
+
+            ast_node*  branch = stmt->right;
+            ast_node** target = pos == RETURNS_NEVER ? &branch->left
+                                                     : &branch->right;
+            ast_node*  rest   = cur->right;
+            cur->right = NULL;
+
+            ast_node* block_seq = *target
+                                    ? make_node(NODE_SEQ, {}, *target, rest)
+                                    : rest;
+            *target = make_node(NODE_BLOCK, {}, NULL, block_seq);
+            (*target)->parent = branch;
+
+            return_kind rest_kind = lower_seq_returns(rest, ret_name);
+            if (rest_kind == RETURNS_UNSUPPORTED)
+                return RETURNS_UNSUPPORTED;
+            return rest_kind == RETURNS_ALWAYS ? RETURNS_ALWAYS
+                                               : RETURNS_SOMETIMES;
+        }
+
+        case RETURNS_UNSUPPORTED:
+        default:
+            return RETURNS_UNSUPPORTED;
+        }
+    }
+    return RETURNS_NEVER;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+
+static return_kind lower_returns(ast_node* stmt, const char* ret_name)
+{
+    return_kind pos = RETURNS_NEVER;
+    return_kind neg = RETURNS_NEVER;
+
+    switch (stmt->type)
+    {
+    case NODE_RET:
+        stmt->type = NODE_ASS;
+        stmt->value.name = strdup(ret_name);
+        return RETURNS_ALWAYS;
+    case NODE_BLOCK:
+        return lower_seq_returns(stmt->right, ret_name);
+    case NODE_IF:
+        return lower_if_returns(stmt, ret_name, &pos, &neg);
+    case NODE_WHILE:
+        return contains_type(stmt->right, NODE_RET) ? RETURNS_UNSUPPORTED
+                                                    : RETURNS_NEVER;
+    default:
+        return RETURNS_NEVER;
+    }
+}
+
+/* Get expression, which is evaluated before statement is executed */
+static ast_node* get_stmt_expr(ast_node* stmt)
+{
+    switch (stmt->type)
+    {
+    case NODE_ASS:
+    case NODE_NVAR:
+    case NODE_RET:
+        return stmt->right;
+    case NODE_CALL:
+        return stmt;
+    case NODE_IF:
+        return stmt->left;
+    default:    // Loop condition is evaluated on every iteration
+        return NULL;
+    }
+}
+
+#pragma GCC diagnostic pop
+
+static inline void replace_child(ast_node* parent, ast_node* child,
+                                 ast_node* replacement)
+{
+    if (parent->left == child)
+        parent->left = replacement;
+    else
+        parent->right = replacement;
+    replacement->parent = parent;
+}
+
+/**
+ * @brief Create block, which declares arguments of inlined function and
+ * executes its body, storing returned value in `ret_name`
+ */
+static ast_node* make_inline_block(const ast_node* callee, const ast_node* call,
+                                   const char* ret_name, size_t id,
+                                   const inline_state* state)
+{
+    size_t arg_cnt = 0;
+    for (const ast_node* arg = callee->left; arg; arg = arg->right)
+        ++ arg_cnt;
+
+    ast_node*     body    = copy_subtree(callee->right);
+    rename_entry* args    = (rename_entry*) calloc(arg_cnt + 1, sizeof(*args));
+    ast_node*     decls   = NULL;
+    ast_node**    decl_end = &decls;
+
+    const ast_node* arg = callee->left;
+    const ast_node* par = call->right;
+    for (size_t i = 0; i < arg_cnt; ++i, arg = arg->right, par = par->right)
+    {
+        args[i].name = arg->value.name;
+        args[i].next = i > 0 ? &args[i - 1] : NULL;
+
+        // Constant arguments are substituted, unless they are modified
+        if (par->left->type == NODE_CONST &&
+                !contains_name(body, NODE_ASS, arg->value.name))
+        {
+            args[i].value = par->left;
+            continue;
+        }
+
+        ast_node* decl = make_node(NODE_NVAR,
+                                   {.name = make_local_name(id, arg->value.name)},
+                                   NULL, copy_subtree(par->left));
+        args[i].value = decl;
+        *decl_end = make_node(NODE_SEQ, {}, decl, NULL);
+        decl_end  = &(*decl_end)->right;
+    }
+
+    const rename_entry* scope = arg_cnt > 0 ? &args[arg_cnt - 1] : NULL;
+    bool renamed = rename_locals(body, scope, id, state);
+    free(args);
+
+    if (!renamed || lower_returns(body, ret_name) == RETURNS_UNSUPPORTED)
+    {
+        delete_subtree(body);
+        if (decls) delete_subtree(decls);
+        return NULL;
+    }
+
+    *decl_end = make_node(NODE_SEQ, {}, body, NULL);
+    return make_node(NODE_BLOCK, {}, NULL, decls);
+}
+
+/* Check whether expression reads variables not declared in caller, except
+ * for ones read in `skipped` subtree */
+static bool reads_globals(const ast_node* node, const ast_node* skipped,
+                          const inline_state* state)
+{
+    if (!node || node == skipped)
+        return false;
+    if (node->type == NODE_VAR &&
+            !declares_name(state->caller, node->value.name))
+        return true;
+    return reads_globals(node->left,  skipped, state)
+        || reads_globals(node->right, skipped, state);
+}
+
+/**
+ * @brief Inline call from expression evaluated by statement. Statement
+ * must contain at most one chain of nested calls and read no global
+ * variables outside of inlined call, so that this innermost call can be
+ * evaluated first without changing program behaviour.
+ *
+ * @param[inout] stmt   Statement, set to `NULL` if it was replaced
+ *
+ * @return `true` if call was inlined, `false` otherwise
+ */
+static bool inline_call_site(ast_node** stmt, inline_state* state)
+{
+    ast_node* expr = get_stmt_expr(*stmt);
+    ast_node* call = NULL;
+    size_t    call_cnt = find_innermost_call(expr, &call);
+    if (!call)
+        return false;
+
+    size_t depth = 0;               // Other calls must contain inlined one
+    for (ast_node* node = call; node != expr; node = node->parent)
+        depth += node->parent->type == NODE_CALL;
+    if (depth + 1 != call_cnt || reads_globals(expr, call, state))
+        return false;
+
+    const ast_node* callee = find_function(state, call->value.name);
+    if (!is_inlinable(callee, state))
+        return false;
+
+    size_t arg_cnt = 0, par_cnt = 0;
+    for (const ast_node* arg = callee->left; arg; arg = arg->right) ++ arg_cnt;
+    for (const ast_node* par = call->right;  par; par = par->right) ++ par_cnt;
+    if (arg_cnt != par_cnt)         // Backend will report the error
+        return false;
+
+    ast_node* parent = (*stmt)->parent;
+    if (parent->type != NODE_SEQ)   // Statement will be moved into new block
+    {
+        if ((*stmt)->type == NODE_NVAR)
+            return false;
+        // Backend requires unconditional return in function body
+        if (contains_type(*stmt, NODE_RET) &&
+                !has_top_level_return(state->caller))
+            return false;
+    }
+
+    size_t    id       = ++ state->inline_cnt;
+    char*     ret_name = make_local_name(id, "ret");
+    ast_node* block    = make_inline_block(callee, call, ret_name, id, state);
+    if (!block)
+    {
+        free(ret_name);
+        return false;
+    }
+
+    ast_node* ret_decl = make_node(NODE_NVAR, {.name = ret_name},
+                                   NULL, make_node(NODE_CONST, {.num = 0},
+                                                   NULL, NULL));
+    ast_node** slot = parent->left == *stmt ? &parent->left : &parent->right;
+    ast_node*  rest = NULL;         // Statements following inlined block
+    if (call == *stmt)              // Result of call is not used
+    {
+        delete_subtree(call);
+        *stmt = NULL;
+    }
+    else
+    {
+        replace_child(call->parent, call,
+                      make_node(NODE_VAR, {.name = strdup(ret_name)},
+                                NULL, NULL));
+        delete_subtree(call);
+        rest = make_node(NODE_SEQ, {}, *stmt, NULL);
+    }
+
+    if (parent->type == NODE_SEQ)   // Reuse sequence node for declaration
+    {
+        if (rest)
+        {
+            rest->right = parent->right;
+            if (rest->right) rest->right->parent = rest;
+        }
+        else
+            rest = parent->right;
+
+        *slot = ret_decl;
+        ret_decl->parent = parent;
+        parent->right = make_node(NODE_SEQ, {}, block, rest);
+        parent->right->parent = parent;
+        return true;
+    }
+
+    *slot = make_node(NODE_BLOCK, {}, NULL,
+                make_node(NODE_SEQ, {}, ret_decl,
+                    make_node(NODE_SEQ, {}, block, rest)));
+    (*slot)->parent = parent;
+    return true;
+}
+
+static void inline_in_seq(ast_node* seq, inline_state* state)
+{
+    while (seq)
+    {
+        ast_node* next = seq->right;    // Inlined code is added before statement
+        inline_in_stmt(seq->left, state);
+        seq = next;
+    }
+}
+
+static void inline_in_stmt(ast_node* stmt, inline_state* state)
+{
+    while (stmt && inline_call_site(&stmt, state))
+        ;   // Inline calls one by one, starting from innermost
+
+    if (!stmt)
+        return;
+
+    if (stmt->type == NODE_BLOCK)
+        inline_in_seq(stmt->right, state);
+    else if (stmt->type == NODE_IF)
+    {
+        inline_in_stmt(stmt->right->left, state);
+        if (stmt->right->right)
+            inline_in_stmt(stmt->right->right, state);
+    }
+    else if (stmt->type == NODE_WHILE)
+        inline_in_stmt(stmt->right, state);
+}
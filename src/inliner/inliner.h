@@ -0,0 +1,29 @@
+/**
+ * @file inliner.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief AST-level function inlining
+ *
+ * @version 0.1
+ * @date 2023-05-28
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __INLINER_INLINER_H
+#define __INLINER_INLINER_H
+
+#include "data_structures/ast/ast.h"
+
+/**
+ * @brief Substitute bodies of small non-recursive functions into their call
+ * sites. Inlined call is evaluated in a block right before the statement
+ * containing it, and its result is stored in a new variable. Return
+ * statements of inlined function become assignments to this variable.
+ *
+ * @param[inout] tree   Program AST
+ *
+ * @return `true` on success, `false` otherwise
+ */
+bool inline_functions(abstract_syntax_tree* tree);
+
+#endif /* inliner.h */
@@ -0,0 +1,603 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "util/logger/logger.h"
+#include "data_structures/ast/ast_dsl.h"
+#include "data_structures/ast/ast_utils.h"
+
+#include "loop_optimizer.h"
+
+/* Loops with larger bodies are not unrolled */
+static const size_t UNROLL_MAX_SIZE = 48;
+
+struct hoisted_expr
+{
+    ast_node*     decl;     // `NVAR` holding value of expression
+    hoisted_expr* next;
+};
+
+struct loop_state;
+
+/**
+ * @brief Transformation of a single loop
+ *
+ * @param[inout] slot       Pointer to loop
+ * @param[in]    seq        Sequence containing the loop or `NULL`
+ * @param[in]    block_seq  First node of sequence containing the loop
+ */
+typedef void loop_transform(ast_node** slot, ast_node* seq,
+                            const ast_node* block_seq, loop_state* state);
+
+struct loop_state
+{
+    const ast_node* defs;           // Program definitions
+    size_t          var_cnt;        // Number of created variables,
+                                    // used in their names
+    unsigned        unroll_factor;
+    loop_transform* transform;
+};
+
+/**
+ * @brief Loop, from which expressions are currently hoisted
+ */
+struct loop_info
+{
+    const ast_node* loop;
+    bool            calls_program;  // Loop calls function defined in program,
+                                    // which can modify global variables
+    hoisted_expr*   hoisted;        // Expressions in order of hoisting
+};
+
+/**
+ * @brief Loop counter, changed by constant integer step once per iteration
+ */
+struct induction_var
+{
+    const char* name;
+    ast_node*   update;     // Sequence node holding counter update
+    double      step;
+};
+
+static loop_transform hoist_from_loop;
+static loop_transform reduce_in_loop;
+static loop_transform unroll_loop;
+
+static void optimize_stmt(ast_node** slot, loop_state* state);
+
+static bool optimize_loops(abstract_syntax_tree* tree, loop_state* state)
+{
+    for (ast_node* def = tree->root; def; def = def->right)
+    {
+        LOG_ASSERT(def->type == NODE_DEFS, return false);
+        if (!def->left || def->left->type != NODE_NFUN)
+            continue;
+
+        optimize_stmt(&def->left->right, state);
+    }
+
+    return true;
+}
+
+bool hoist_loop_invariants(abstract_syntax_tree* tree)
+{
+    LOG_ASSERT(tree != NULL, return false);
+    LOG_ASSERT(tree->root != NULL, return false);
+
+    loop_state state = { .defs = tree->root, .var_cnt = 0,
+                         .unroll_factor = 1, .transform = hoist_from_loop };
+    return optimize_loops(tree, &state);
+}
+
+bool reduce_induction_vars(abstract_syntax_tree* tree)
+{
+    LOG_ASSERT(tree != NULL, return false);
+    LOG_ASSERT(tree->root != NULL, return false);
+
+    loop_state state = { .defs = tree->root, .var_cnt = 0,
+                         .unroll_factor = 1, .transform = reduce_in_loop };
+    return optimize_loops(tree, &state);
+}
+
+bool unroll_loops(abstract_syntax_tree* tree, unsigned factor)
+{
+    LOG_ASSERT(tree != NULL, return false);
+    LOG_ASSERT(tree->root != NULL, return false);
+    LOG_ASSERT(factor >= 1, return false);
+
+    loop_state state = { .defs = tree->root, .var_cnt = 0,
+                         .unroll_factor = factor, .transform = unroll_loop };
+    return optimize_loops(tree, &state);
+}
+
+static size_t count_assignments(const ast_node* node, const char* name)
+{
+    if (!node) return 0;
+    return (node->type == NODE_ASS && strcmp(node->value.name, name) == 0)
+         + count_assignments(node->left,  name)
+         + count_assignments(node->right, name);
+}
+
+/**
+ * @brief Check whether expression has the same value on every iteration
+ * and can be evaluated before the loop. Division is never hoisted, as it
+ * could trap in a loop which is not executed at all.
+ */
+static bool is_invariant(const ast_node* expr, const loop_info* info,
+                         const loop_state* state)
+{
+    switch (expr->type)
+    {
+    case NODE_CONST:
+        return true;
+    case NODE_VAR:
+        if (contains_name(info->loop, NODE_ASS,  expr->value.name) ||
+            contains_name(info->loop, NODE_NVAR, expr->value.name))
+            return false;
+        return !info->calls_program
+            || !is_global_var(state->defs, expr->value.name);
+    case NODE_OP:
+        if (expr->value.op == OP_DIV)
+            return false;
+        return (!expr->left || is_invariant(expr->left,  info, state))
+            && is_invariant(expr->right, info, state);
+
+    case NODE_DEFS: case NODE_NVAR: case NODE_NFUN: case NODE_ARG:
+    case NODE_BLOCK: case NODE_SEQ: case NODE_ASS: case NODE_IF:
+    case NODE_BRANCH: case NODE_WHILE: case NODE_RET: case NODE_CALL:
+    case NODE_PAR: case NODE_CMP: case NODE_LOGIC:
+    default:
+        return false;
+    }
+}
+
+/* Loading variable is cheaper than multiplication or several operations */
+static bool is_worth_hoisting(const ast_node* expr)
+{
+    if (!contains_type(expr, NODE_VAR)) // Constants are left to simplifier
+        return false;
+    return expr->value.op == OP_MUL || count_ops(expr) >= 2;
+}
+
+static inline void append_stmt(ast_node*** seq_end, ast_node* stmt)
+{
+    **seq_end = make_node(NODE_SEQ, {}, stmt, NULL);
+    *seq_end  = &(**seq_end)->right;
+}
+
+/**
+ * @brief Put statements before loop
+ *
+ * @param[inout] slot   Pointer to loop, which is replaced with block,
+ *                      unless loop is a part of statement sequence
+ * @param[in]    seq    Sequence containing the loop or `NULL`
+ * @param[in]    stmts  Non-empty sequence of statements
+ */
+static void insert_before_loop(ast_node** slot, ast_node* seq, ast_node* stmts)
+{
+    ast_node* last = stmts;
+    while (last->right)
+        last = last->right;
+    last->right = make_node(NODE_SEQ, {}, *slot, seq ? seq->right : NULL);
+
+    if (seq)                        // Reuse sequence node for first statement
+    {
+        seq->left  = stmts->left;
+        seq->right = stmts->right;
+        stmts->left  = NULL;
+        stmts->right = NULL;
+        delete_node(stmts);
+        return;
+    }
+
+    *slot = make_node(NODE_BLOCK, {}, NULL, stmts);
+}
+
+/**
+ * @brief Get variable holding value of expression, creating its declaration
+ * if expression was not seen before
+ */
+static const char* get_hoisted_var(const ast_node* expr, const char* prefix,
+                                   loop_info* info, loop_state* state)
+{
+    hoisted_expr** last = &info->hoisted;
+    for (; *last; last = &(*last)->next)
+        if (is_same_expr((*last)->decl->right, expr))
+            return (*last)->decl->value.name;
+
+    ast_node* decl = make_node(NODE_NVAR,
+                               {.name = make_var_name(prefix, ++state->var_cnt)},
+                               NULL, copy_subtree(expr));
+
+    *last = (hoisted_expr*) calloc(1, sizeof(**last));
+    (*last)->decl = decl;
+    return decl->value.name;
+}
+
+/* Replace expression with variable holding its value */
+static void replace_with_var(ast_node** slot, const char* name)
+{
+    ast_node* node = *slot;
+    *slot = make_var_node(name);
+    (*slot)->parent = node->parent;
+    delete_subtree(node);
+}
+
+/* Move declarations of hoisted expressions to sequence, freeing the list */
+static void append_decls(ast_node*** seq_end, hoisted_expr* hoisted)
+{
+    while (hoisted)
+    {
+        append_stmt(seq_end, hoisted->decl);
+
+        hoisted_expr* next = hoisted->next;
+        free(hoisted);
+        hoisted = next;
+    }
+}
+
+/* Replace largest invariant subexpressions with hoisted variables */
+static void hoist_from(ast_node** slot, loop_info* info, loop_state* state)
+{
+    ast_node* node = *slot;
+    if (!node) return;
+
+    if (node->type == NODE_OP && is_worth_hoisting(node) &&
+            is_invariant(node, info, state))
+    {
+        replace_with_var(slot, get_hoisted_var(node, "licm", info, state));
+        return;
+    }
+
+    hoist_from(&node->left,  info, state);
+    hoist_from(&node->right, info, state);
+}
+
+static void hoist_from_loop(ast_node** slot, ast_node* seq,
+                            const ast_node*, loop_state* state)
+{
+    ast_node* loop = *slot;
+    loop_info info = {
+        .loop = loop,
+        .calls_program = calls_program_function(loop, state->defs),
+        .hoisted = NULL
+    };
+
+    hoist_from(&loop->left,  &info, state);
+    hoist_from(&loop->right, &info, state);
+    if (!info.hoisted)
+        return;
+
+    ast_node*  decls    = NULL;
+    ast_node** decl_end = &decls;
+    append_decls(&decl_end, info.hoisted);
+    insert_before_loop(slot, seq, decls);
+}
+
+/* Get constant added to variable by assignment or `NAN` */
+static double get_var_step(const ast_node* assign)
+{
+    const char*     name = assign->value.name;
+    const ast_node* expr = assign->right;
+    if (!is_op(expr) || !expr->left)
+        return NAN;
+
+    if (op_cmp(expr, OP_ADD) && var_cmp(expr->left, name) && is_num(expr->right))
+        return get_num(expr->right);
+    if (op_cmp(expr, OP_ADD) && var_cmp(expr->right, name) && is_num(expr->left))
+        return get_num(expr->left);
+    if (op_cmp(expr, OP_SUB) && var_cmp(expr->left, name) && is_num(expr->right))
+        return -get_num(expr->right);
+    return NAN;
+}
+
+/**
+ * @brief Find loop counter, which is changed by non-zero integer constant
+ * at the top level of loop body and is not changed anywhere else in the loop
+ *
+ * @param[inout] from   Sequence node to start search from, set to node
+ *                      following found update
+ */
+static bool find_induction_var(const loop_info* info, ast_node** from,
+                               const loop_state* state, induction_var* iv)
+{
+    for (ast_node* seq = *from; seq; seq = seq->right)
+    {
+        const ast_node* stmt = seq->left;
+        if (!stmt || stmt->type != NODE_ASS)
+            continue;
+
+        double step = get_var_step(stmt);
+        if (isnan(step) || compare_double(step, round(step)) != 0 ||
+                compare_double(step, 0) == 0)
+            continue;
+        if (count_assignments(info->loop, stmt->value.name) != 1 ||
+                contains_name(info->loop, NODE_NVAR, stmt->value.name))
+            continue;
+        if (info->calls_program && is_global_var(state->defs, stmt->value.name))
+            continue;
+
+        iv->name   = stmt->value.name;
+        iv->update = seq;
+        iv->step   = round(step);
+        *from = seq->right;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Check whether variable holds integer value, when statement `end`
+ * of sequence `block_seq` is reached
+ */
+static bool has_integer_value(const char* name, const ast_node* block_seq,
+                              const ast_node* end, const loop_state* state)
+{
+    bool is_integer = false;
+    for (const ast_node* seq = block_seq; seq && seq != end; seq = seq->right)
+    {
+        const ast_node* stmt = seq->left;
+        if ((stmt->type == NODE_NVAR || stmt->type == NODE_ASS) &&
+                strcmp(stmt->value.name, name) == 0)
+            is_integer = is_integer_const(stmt->right);
+        else if (contains_name(stmt, NODE_ASS, name))
+            is_integer = false;
+        else if (is_global_var(state->defs, name) &&
+                    calls_program_function(stmt, state->defs))
+            is_integer = false;
+    }
+    return is_integer;
+}
+
+/* Replace products of counter and invariant expressions with variables */
+static void reduce_products(ast_node** slot, const induction_var* iv,
+                            loop_info* info, loop_state* state)
+{
+    ast_node* node = *slot;
+    if (!node) return;
+
+    const ast_node* factor = NULL;
+    if (op_cmp(node, OP_MUL))
+        factor = var_cmp(node->left,  iv->name) ? node->right
+               : var_cmp(node->right, iv->name) ? node->left
+               : NULL;
+
+    // Multiplication by integer constant needs no rescaling and is cheap
+    if (factor && !is_integer_const(factor) && is_invariant(factor, info, state))
+    {
+        replace_with_var(slot, get_hoisted_var(node, "iv", info, state));
+        return;
+    }
+
+    reduce_products(&node->left,  iv, info, state);
+    reduce_products(&node->right, iv, info, state);
+}
+
+/**
+ * @brief Add updates of reduced products right after counter update. As
+ * counter holds integers, product is computed exactly, and adding product
+ * of step and factor keeps it exact.
+ *
+ * @param[inout] decl_end   End of sequence of declarations put before loop
+ */
+static void add_product_updates(const induction_var* iv,
+                                const hoisted_expr* products,
+                                loop_state* state, ast_node*** decl_end)
+{
+    for (const hoisted_expr* expr = products; expr; expr = expr->next)
+    {
+        const ast_node* product = expr->decl->right;
+        const ast_node* factor  = var_cmp(product->left, iv->name)
+                                        ? product->right : product->left;
+
+        ast_node* step = NULL;
+        if (compare_double(iv->step, 1) == 0 && (is_num(factor) || is_var(factor)))
+            step = copy_subtree(factor);
+        else
+        {
+            ast_node* decl = make_node(NODE_NVAR,
+                                {.name = make_var_name("ivstep", ++state->var_cnt)},
+                                NULL,
+                                make_binary_node(OP_MUL,
+                                                 make_number_node(iv->step),
+                                                 copy_subtree(factor)));
+            append_stmt(decl_end, decl);
+            step = make_var_node(decl->value.name);
+        }
+
+        const char* name = expr->decl->value.name;
+        ast_node* update = make_node(NODE_ASS, {.name = strdup(name)}, NULL,
+                                     make_binary_node(OP_ADD,
+                                                      make_var_node(name),
+                                                      step));
+        iv->update->right = make_node(NODE_SEQ, {}, update, iv->update->right);
+    }
+}
+
+static void reduce_in_loop(ast_node** slot, ast_node* seq,
+                           const ast_node* block_seq, loop_state* state)
+{
+    ast_node* loop = *slot;
+    if (!seq || !loop->right || loop->right->type != NODE_BLOCK)
+        return;     // Initial value of counter cannot be found
+
+    loop_info info = {
+        .loop = loop,
+        .calls_program = calls_program_function(loop, state->defs),
+        .hoisted = NULL
+    };
+
+    ast_node*  decls    = NULL;
+    ast_node** decl_end = &decls;
+
+    ast_node* from = loop->right->right;
+    induction_var iv = {};
+    while (find_induction_var(&info, &from, state, &iv))
+    {
+        if (!has_integer_value(iv.name, block_seq, seq, state))
+            continue;
+
+        info.hoisted = NULL;
+        reduce_products(&loop->left,  &iv, &info, state);
+        reduce_products(&loop->right, &iv, &info, state);
+
+        add_product_updates(&iv, info.hoisted, state, &decl_end);
+        append_decls(&decl_end, info.hoisted);
+    }
+
+    if (decls)
+        insert_before_loop(slot, seq, decls);
+}
+
+/**
+ * @brief Get counter and bound from loop condition `i < n` or `i <= n`
+ * (or equivalent `n . i` and `n >= i`)
+ */
+static bool get_loop_bound(const ast_node* cond, const char** name,
+                           const ast_node** bound, op_type* op)
+{
+    if ((op_cmp(cond, OP_LT) || op_cmp(cond, OP_LEQ)) && is_var(cond->left))
+    {
+        *name  = get_var(cond->left);
+        *bound = cond->right;
+        *op    = get_op(cond);
+        return true;
+    }
+    if ((op_cmp(cond, OP_GT) || op_cmp(cond, OP_GEQ)) && is_var(cond->right))
+    {
+        *name  = get_var(cond->right);
+        *bound = cond->left;
+        *op    = op_cmp(cond, OP_GT) ? OP_LT : OP_LEQ;
+        return true;
+    }
+    return false;
+}
+
+static bool declares_in_seq(const ast_node* seq)
+{
+    for (; seq; seq = seq->right)
+        if (seq->left && seq->left->type == NODE_NVAR)
+            return true;
+    return false;
+}
+
+/**
+ * @brief Put loop, which executes several copies of body per iteration,
+ * before the original one. Unrolled loop runs while counter stays below
+ * the bound for all copies, and the original loop executes the rest.
+ */
+static void unroll_loop(ast_node** slot, ast_node* seq,
+                        const ast_node*, loop_state* state)
+{
+    ast_node* loop = *slot;
+    ast_node* body = loop->right;
+    if (state->unroll_factor < 2 || !body || body->type != NODE_BLOCK ||
+            contains_type(body, NODE_WHILE) ||
+            count_nodes(body) > UNROLL_MAX_SIZE)
+        return;
+
+    const char*     name  = NULL;
+    const ast_node* bound = NULL;
+    op_type         op    = OP_LT;
+    if (!get_loop_bound(loop->left, &name, &bound, &op))
+        return;
+
+    loop_info info = {
+        .loop = loop,
+        .calls_program = calls_program_function(loop, state->defs),
+        .hoisted = NULL
+    };
+    if (!is_invariant(bound, &info, state))
+        return;
+
+    ast_node* from = body->right;
+    induction_var iv = {};
+    bool found = false;
+    while (!found && find_induction_var(&info, &from, state, &iv))
+        found = strcmp(iv.name, name) == 0;
+    if (!found || iv.step < 0)
+        return;
+
+    ast_node*  stmts    = NULL;
+    ast_node** stmt_end = &stmts;
+
+    const double offset = iv.step * (state->unroll_factor - 1);
+    ast_node* unrolled_bound = NULL;
+    if (is_num(bound))
+        unrolled_bound = make_number_node(get_num(bound) - offset);
+    else
+    {
+        ast_node* decl = make_node(NODE_NVAR,
+                            {.name = make_var_name("unroll", ++state->var_cnt)},
+                            NULL,
+                            make_binary_node(OP_SUB, copy_subtree(bound),
+                                             make_number_node(offset)));
+        append_stmt(&stmt_end, decl);
+        unrolled_bound = make_var_node(decl->value.name);
+    }
+
+    // Copies are put into separate blocks, if they declare variables
+    const bool need_scope = declares_in_seq(body->right);
+    ast_node*  copies   = NULL;
+    ast_node** copy_end = &copies;
+    for (unsigned i = 0; i < state->unroll_factor; ++i)
+    {
+        ast_node* copy = copy_subtree(body->right);
+        if (need_scope)
+        {
+            append_stmt(&copy_end, make_node(NODE_BLOCK, {}, NULL, copy));
+            continue;
+        }
+        *copy_end = copy;
+        while (*copy_end)
+            copy_end = &(*copy_end)->right;
+    }
+
+    append_stmt(&stmt_end, make_node(NODE_WHILE, {},
+                            make_binary_node(op, make_var_node(name),
+                                             unrolled_bound),
+                            make_node(NODE_BLOCK, {}, NULL, copies)));
+    insert_before_loop(slot, seq, stmts);
+}
+
+static void optimize_seq(ast_node* block_seq, loop_state* state)
+{
+    ast_node* seq = block_seq;
+    while (seq)
+    {
+        // Statements are inserted before loop
+        ast_node* next = seq->right;
+        if (seq->left && seq->left->type == NODE_WHILE)
+        {
+            ast_node* loop = seq->left;
+            state->transform(&seq->left, seq, block_seq, state);
+            optimize_stmt(&loop->right, state);
+        }
+        else
+            optimize_stmt(&seq->left, state);
+        seq = next;
+    }
+}
+
+static void optimize_stmt(ast_node** slot, loop_state* state)
+{
+    ast_node* stmt = *slot;
+    if (!stmt)
+        return;
+
+    if (stmt->type == NODE_BLOCK)
+        optimize_seq(stmt->right, state);
+    else if (stmt->type == NODE_IF)
+    {
+        optimize_stmt(&stmt->right->left,  state);
+        optimize_stmt(&stmt->right->right, state);
+    }
+    else if (stmt->type == NODE_WHILE)
+    {
+        // Expressions invariant in outer loop are also invariant in inner
+        // loops, so outer loops are processed first
+        state->transform(slot, NULL, NULL, state);
+        optimize_stmt(&stmt->right, state);
+    }
+}
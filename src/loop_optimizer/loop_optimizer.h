@@ -0,0 +1,52 @@
+/**
+ * @file loop_optimizer.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief AST-level loop optimizations
+ *
+ * @version 0.1
+ * @date 2023-05-29
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __LOOP_OPTIMIZER_LOOP_OPTIMIZER_H
+#define __LOOP_OPTIMIZER_LOOP_OPTIMIZER_H
+
+#include "data_structures/ast/ast.h"
+
+/**
+ * @brief Move expressions, which do not change during loop execution, out
+ * of `vile` loops. Each hoisted expression is evaluated once into a new
+ * variable declared right before the loop.
+ *
+ * @param[inout] tree   Program AST
+ *
+ * @return `true` on success, `false` otherwise
+ */
+bool hoist_loop_invariants(abstract_syntax_tree* tree);
+
+/**
+ * @brief Replace products of loop counters and invariant expressions with
+ * variables, which are increased together with counter. Only counters
+ * holding integers and changed by integer constant are considered, so that
+ * fixed-point products stay exact.
+ *
+ * @param[inout] tree   Program AST
+ *
+ * @return `true` on success, `false` otherwise
+ */
+bool reduce_induction_vars(abstract_syntax_tree* tree);
+
+/**
+ * @brief Unroll innermost `vile` loops of form `vile ( i < n 0`, where `n`
+ * is invariant and `i` is increased by integer constant once per
+ * iteration. Original loop is kept to execute remaining iterations.
+ *
+ * @param[inout] tree   Program AST
+ * @param[in]    factor Number of body copies in unrolled loop
+ *
+ * @return `true` on success, `false` otherwise
+ */
+bool unroll_loops(abstract_syntax_tree* tree, unsigned factor);
+
+#endif /* loop_optimizer.h */
@@ -0,0 +1,581 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "util/logger/logger.h"
+#include "data_structures/ast/ast_dsl.h"
+#include "data_structures/ast/ast_utils.h"
+
+#include "propagator.h"
+
+/**
+ * @brief Variable known to hold value of expression at current point
+ */
+struct value_fact
+{
+    const char* name;
+    ast_node*   value;      // Copy of expression without calls
+    value_fact* next;
+};
+
+struct propagation_state
+{
+    const ast_node* defs;           // Program definitions
+    size_t          var_cnt;        // Number of created variables,
+                                    // used in their names
+    value_fact*     facts;
+    bool            is_reachable;   // Current statement can be executed
+};
+
+/**
+ * @brief Result of search for repeated expression in following statements
+ */
+enum reuse_result
+{
+    REUSE_NONE,
+    REUSE_FOUND,
+    REUSE_KILLED    // Variable used in expression is changed before reuse
+};
+
+static void propagate_in_stmt(ast_node** slot, propagation_state* state);
+static void free_facts(value_fact* facts);
+
+bool propagate_values(abstract_syntax_tree* tree)
+{
+    LOG_ASSERT(tree != NULL, return false);
+    LOG_ASSERT(tree->root != NULL, return false);
+
+    propagation_state state = { .defs = tree->root, .var_cnt = 0,
+                                .facts = NULL, .is_reachable = true };
+
+    for (ast_node* def = tree->root; def; def = def->right)
+    {
+        LOG_ASSERT(def->type == NODE_DEFS, return false);
+        if (!def->left || def->left->type != NODE_NFUN)
+            continue;
+
+        state.is_reachable = true;
+        propagate_in_stmt(&def->left->right, &state);
+        free_facts(state.facts);
+        state.facts = NULL;
+    }
+
+    return true;
+}
+
+static bool uses_global_var(const ast_node* expr,
+                            const propagation_state* state)
+{
+    if (!expr) return false;
+    if (expr->type == NODE_VAR && is_global_var(state->defs, expr->value.name))
+        return true;
+    return uses_global_var(expr->left,  state)
+        || uses_global_var(expr->right, state);
+}
+
+static size_t count_expr(const ast_node* node, const ast_node* expr)
+{
+    if (!node) return 0;
+    if (is_same_expr(node, expr)) return 1;
+    return count_expr(node->left, expr) + count_expr(node->right, expr);
+}
+
+static inline bool is_arithmetic(const ast_node* node)
+{
+    return op_cmp(node, OP_ADD) || op_cmp(node, OP_SUB)
+        || op_cmp(node, OP_MUL) || op_cmp(node, OP_DIV)
+        || op_cmp(node, OP_NEG);
+}
+
+/* Loading variable is cheaper than multiplication or several operations */
+static bool is_worth_sharing(const ast_node* expr)
+{
+    if (!is_arithmetic(expr) || !contains_type(expr, NODE_VAR) ||
+            contains_type(expr, NODE_CALL))
+        return false;
+    return op_cmp(expr, OP_MUL) || op_cmp(expr, OP_DIV) || count_ops(expr) >= 2;
+}
+
+static void free_facts(value_fact* facts)
+{
+    while (facts)
+    {
+        value_fact* next = facts->next;
+        delete_subtree(facts->value);
+        free(facts);
+        facts = next;
+    }
+}
+
+static value_fact* copy_facts(const value_fact* facts)
+{
+    value_fact*  result = NULL;
+    value_fact** last   = &result;
+    for (; facts; facts = facts->next)
+    {
+        *last = (value_fact*) calloc(1, sizeof(**last));
+        (*last)->name  = facts->name;
+        (*last)->value = copy_subtree(facts->value);
+        last = &(*last)->next;
+    }
+    return result;
+}
+
+/**
+ * @brief Check whether fact should be forgotten
+ *
+ * @param[in] fact      Checked fact
+ * @param[in] context   Filter-specific data
+ */
+typedef bool fact_filter(const value_fact* fact, const void* context);
+
+static void remove_facts(value_fact** facts, fact_filter* is_removed,
+                         const void* context)
+{
+    while (*facts)
+    {
+        value_fact* fact = *facts;
+        if (!is_removed(fact, context))
+        {
+            facts = &fact->next;
+            continue;
+        }
+        *facts = fact->next;
+        delete_subtree(fact->value);
+        free(fact);
+    }
+}
+
+static bool uses_var(const value_fact* fact, const void* name)
+{
+    return strcmp(fact->name, (const char*) name) == 0
+        || contains_name(fact->value, NODE_VAR, (const char*) name);
+}
+
+static bool uses_global(const value_fact* fact, const void* state)
+{
+    const propagation_state* prop = (const propagation_state*) state;
+    return is_global_var(prop->defs, fact->name)
+        || uses_global_var(fact->value, prop);
+}
+
+static bool is_not_in(const value_fact* fact, const void* facts)
+{
+    for (const value_fact* cur = (const value_fact*) facts; cur; cur = cur->next)
+        if (strcmp(cur->name, fact->name) == 0 &&
+                is_same_expr(cur->value, fact->value))
+            return false;
+    return true;
+}
+
+/* Forget facts about variable and expressions using it */
+static inline void kill_var(propagation_state* state, const char* name)
+{
+    remove_facts(&state->facts, uses_var, name);
+}
+
+/* Forget facts, which can be invalidated by call of program function */
+static inline void kill_globals(propagation_state* state)
+{
+    remove_facts(&state->facts, uses_global, state);
+}
+
+/* Forget facts about all variables assigned or declared in statement */
+static void kill_changed_vars(propagation_state* state, const ast_node* stmt)
+{
+    if (!stmt) return;
+    if (stmt->type == NODE_ASS || stmt->type == NODE_NVAR)
+        kill_var(state, stmt->value.name);
+    kill_changed_vars(state, stmt->left);
+    kill_changed_vars(state, stmt->right);
+}
+
+/* Keep only facts, which also hold in `other` */
+static inline void intersect_facts(value_fact** facts, const value_fact* other)
+{
+    remove_facts(facts, is_not_in, other);
+}
+
+static const value_fact* find_var_fact(const propagation_state* state,
+                                       const char* name)
+{
+    for (const value_fact* fact = state->facts; fact; fact = fact->next)
+        if (strcmp(fact->name, name) == 0)
+            return fact;
+    return NULL;
+}
+
+static const value_fact* find_expr_fact(const propagation_state* state,
+                                        const ast_node* expr)
+{
+    for (const value_fact* fact = state->facts; fact; fact = fact->next)
+        if (is_same_expr(fact->value, expr))
+            return fact;
+    return NULL;
+}
+
+static void add_fact(propagation_state* state, const char* name,
+                     const ast_node* value)
+{
+    if (contains_type(value, NODE_CALL) || contains_name(value, NODE_VAR, name))
+        return;
+
+    value_fact* fact = (value_fact*) calloc(1, sizeof(*fact));
+    fact->name  = name;
+    fact->value = copy_subtree(value);
+    fact->next  = state->facts;
+    state->facts = fact;
+}
+
+static void replace_node(ast_node** slot, ast_node* replacement)
+{
+    ast_node* node = *slot;
+    replacement->parent = node->parent;
+    *slot = replacement;
+    delete_subtree(node);
+}
+
+/* Integer arithmetic is exact in every number representation */
+static void fold_integer_op(ast_node** slot)
+{
+    ast_node* node = *slot;
+    if (op_cmp(node, OP_NEG) && is_integer_const(node->right))
+    {
+        replace_node(slot, make_number_node(-get_num(node->right)));
+        return;
+    }
+    if (!is_integer_const(node->left) || !is_integer_const(node->right))
+        return;
+
+    const double left  = get_num(node->left);
+    const double right = get_num(node->right);
+    switch (get_op(node))
+    {
+    case OP_ADD: replace_node(slot, make_number_node(left + right)); break;
+    case OP_SUB: replace_node(slot, make_number_node(left - right)); break;
+    case OP_MUL: replace_node(slot, make_number_node(left * right)); break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Substitute known values of variables and replace expressions,
+ * which are held by variables
+ */
+static void rewrite_expr(ast_node** slot, const propagation_state* state)
+{
+    ast_node* node = *slot;
+    if (!node) return;
+
+    if (node->type == NODE_VAR)
+    {
+        const value_fact* fact = find_var_fact(state, node->value.name);
+        if (fact && is_integer_const(fact->value))
+            replace_node(slot, make_number_node(get_num(fact->value)));
+        else if (fact && is_var(fact->value))
+            replace_node(slot, make_var_node(get_var(fact->value)));
+        return;
+    }
+
+    rewrite_expr(&node->left,  state);
+    rewrite_expr(&node->right, state);
+    if (node->type != NODE_OP)
+        return;
+
+    fold_integer_op(slot);
+    if (!is_op(*slot))
+        return;
+
+    const value_fact* fact = find_expr_fact(state, *slot);
+    if (fact)
+        replace_node(slot, make_var_node(fact->name));
+}
+
+/* Check whether statement changes variables used in expression */
+static bool kills_expr(const ast_node* stmt, const ast_node* expr,
+                       const propagation_state* state)
+{
+    if (calls_program_function(stmt, state->defs)
+            && uses_global_var(expr, state))
+        return true;
+
+    if (!stmt) return false;
+    if ((stmt->type == NODE_ASS || stmt->type == NODE_NVAR) &&
+            contains_name(expr, NODE_VAR, stmt->value.name))
+        return true;
+    return kills_expr(stmt->left,  expr, state)
+        || kills_expr(stmt->right, expr, state);
+}
+
+static reuse_result find_reuse_in_seq(const ast_node* seq,
+                                      const ast_node* expr,
+                                      const propagation_state* state);
+
+/* Called function can change globals used in expression before it is
+ * evaluated */
+static inline bool is_reordered(const ast_node* stmt_expr,
+                                const ast_node* expr,
+                                const propagation_state* state)
+{
+    return calls_program_function(stmt_expr, state->defs)
+        && uses_global_var(expr, state);
+}
+
+/**
+ * @brief Check whether expression is evaluated again by statement, before
+ * any variable it uses is changed
+ */
+static reuse_result find_reuse_in_stmt(const ast_node* stmt,
+                                       const ast_node* expr,
+                                       const propagation_state* state)
+{
+    if (!stmt)
+        return REUSE_NONE;
+
+    switch (stmt->type)
+    {
+    case NODE_NVAR: case NODE_ASS: case NODE_RET: case NODE_CALL:
+        if (is_reordered(stmt, expr, state))
+            return REUSE_KILLED;
+        if (count_expr(stmt, expr) > 0)     // Value is used before assignment
+            return REUSE_FOUND;
+        return kills_expr(stmt, expr, state) ? REUSE_KILLED : REUSE_NONE;
+
+    case NODE_BLOCK:
+        return find_reuse_in_seq(stmt->right, expr, state);
+
+    case NODE_IF:
+    {
+        if (is_reordered(stmt->left, expr, state))
+            return REUSE_KILLED;
+        if (count_expr(stmt->left, expr) > 0)
+            return REUSE_FOUND;
+        if (kills_expr(stmt->left, expr, state))
+            return REUSE_KILLED;
+
+        reuse_result pos = find_reuse_in_stmt(stmt->right->left,  expr, state);
+        reuse_result neg = find_reuse_in_stmt(stmt->right->right, expr, state);
+        if (pos == REUSE_FOUND || neg == REUSE_FOUND)
+            return REUSE_FOUND;
+        return pos == REUSE_KILLED || neg == REUSE_KILLED ? REUSE_KILLED
+                                                          : REUSE_NONE;
+    }
+
+    case NODE_WHILE:
+        // Facts about variables changed by loop are lost before the loop
+        if (kills_expr(stmt, expr, state))
+            return REUSE_KILLED;
+        return count_expr(stmt, expr) > 0 ? REUSE_FOUND : REUSE_NONE;
+
+    case NODE_DEFS: case NODE_NFUN: case NODE_ARG: case NODE_SEQ:
+    case NODE_BRANCH: case NODE_PAR: case NODE_OP: case NODE_CMP:
+    case NODE_LOGIC: case NODE_VAR: case NODE_CONST:
+    default:
+        return kills_expr(stmt, expr, state) ? REUSE_KILLED : REUSE_NONE;
+    }
+}
+
+static reuse_result find_reuse_in_seq(const ast_node* seq,
+                                      const ast_node* expr,
+                                      const propagation_state* state)
+{
+    for (; seq; seq = seq->right)
+    {
+        reuse_result result = find_reuse_in_stmt(seq->left, expr, state);
+        if (result != REUSE_NONE)
+            return result;
+    }
+    return REUSE_NONE;
+}
+
+/* Get expression evaluated by statement before any other action */
+static const ast_node* get_stmt_expr(const ast_node* stmt)
+{
+    switch (stmt->type)
+    {
+    case NODE_NVAR: case NODE_ASS: case NODE_RET:
+        return stmt->right;
+    case NODE_CALL:
+        return stmt;
+    case NODE_IF:
+        return stmt->left;
+
+    case NODE_DEFS: case NODE_NFUN: case NODE_ARG: case NODE_BLOCK:
+    case NODE_SEQ: case NODE_BRANCH: case NODE_WHILE: case NODE_PAR:
+    case NODE_OP: case NODE_CMP: case NODE_LOGIC: case NODE_VAR:
+    case NODE_CONST:
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief Evaluate largest subexpressions of statement, which are evaluated
+ * again later, into new variables declared before the statement
+ *
+ * @param[inout] seq    Sequence node holding the statement, set to node
+ *                      holding it after declarations are inserted
+ */
+static void share_subexprs(const ast_node* expr, ast_node** seq,
+                           propagation_state* state)
+{
+    if (!expr)
+        return;
+
+    const ast_node* stmt_expr = get_stmt_expr((*seq)->left);
+    if (is_worth_sharing(expr) && !is_reordered(stmt_expr, expr, state) &&
+            (count_expr(stmt_expr, expr) > 1 ||
+             find_reuse_in_seq((*seq)->right, expr, state) == REUSE_FOUND))
+    {
+        ast_node* value = copy_subtree(expr);
+        rewrite_expr(&value, state);
+        if (!is_op(value))  // Value is already held by variable
+        {
+            delete_subtree(value);
+            return;
+        }
+
+        ast_node* decl = make_node(NODE_NVAR,
+                            {.name = make_var_name("gvn", ++state->var_cnt)},
+                            NULL, value);
+
+        (*seq)->right = make_node(NODE_SEQ, {}, (*seq)->left, (*seq)->right);
+        (*seq)->left  = decl;
+        propagate_in_stmt(&(*seq)->left, state);
+        *seq = (*seq)->right;
+        return;
+    }
+
+    share_subexprs(expr->left, seq, state);
+    if (!op_cmp(expr, OP_AND) && !op_cmp(expr, OP_OR))  // Can be skipped
+        share_subexprs(expr->right, seq, state);
+}
+
+static void propagate_in_seq(ast_node* seq, propagation_state* state)
+{
+    for (; seq && state->is_reachable; seq = seq->right)
+    {
+        const ast_node* expr = get_stmt_expr(seq->left);
+        if (expr)   // Declarations are inserted before statement
+            share_subexprs(expr, &seq, state);
+        propagate_in_stmt(&seq->left, state);
+    }
+}
+
+/* Statement, which is not a block, can still declare variable */
+static void kill_declared(propagation_state* state, const ast_node* stmt)
+{
+    if (stmt && stmt->type == NODE_NVAR)
+        kill_var(state, stmt->value.name);
+}
+
+static void propagate_in_if(ast_node* stmt, propagation_state* state)
+{
+    ast_node* branch = stmt->right;
+    value_fact* facts = copy_facts(state->facts);
+
+    propagate_in_stmt(&branch->left, state);
+    value_fact* pos_facts = state->facts;
+    bool pos_reachable = state->is_reachable;
+
+    state->facts = facts;
+    state->is_reachable = true;
+    propagate_in_stmt(&branch->right, state);
+
+    if (!pos_reachable)
+        free_facts(pos_facts);
+    else if (!state->is_reachable)
+    {
+        free_facts(state->facts);
+        state->facts = pos_facts;
+        state->is_reachable = true;
+    }
+    else
+    {
+        intersect_facts(&state->facts, pos_facts);
+        free_facts(pos_facts);
+    }
+
+    kill_declared(state, branch->left);
+    kill_declared(state, branch->right);
+}
+
+static void propagate_in_stmt(ast_node** slot, propagation_state* state)
+{
+    ast_node* stmt = *slot;
+    if (!stmt)
+        return;
+
+    switch (stmt->type)
+    {
+    case NODE_NVAR: case NODE_ASS:
+    {
+        // Called function can change globals before they are read
+        if (calls_program_function(stmt->right, state->defs))
+            kill_globals(state);
+        rewrite_expr(&stmt->right, state);
+        if (var_cmp(stmt->right, stmt->value.name))
+            return;     // Variable keeps its value
+
+        kill_var(state, stmt->value.name);
+        add_fact(state, stmt->value.name, stmt->right);
+        return;
+    }
+
+    case NODE_CALL:
+        if (calls_program_function(stmt, state->defs))
+            kill_globals(state);
+        rewrite_expr(&stmt->right, state);
+        return;
+
+    case NODE_RET:
+        if (calls_program_function(stmt->right, state->defs))
+            kill_globals(state);
+        rewrite_expr(&stmt->right, state);
+        state->is_reachable = false;
+        return;
+
+    case NODE_BLOCK:
+        propagate_in_seq(stmt->right, state);
+        for (const ast_node* seq = stmt->right; seq; seq = seq->right)
+            kill_declared(state, seq->left);
+        if (!state->is_reachable)
+        {
+            free_facts(state->facts);
+            state->facts = NULL;
+        }
+        return;
+
+    case NODE_IF:
+        if (calls_program_function(stmt->left, state->defs))
+            kill_globals(state);
+        rewrite_expr(&stmt->left, state);
+        propagate_in_if(stmt, state);
+        return;
+
+    case NODE_WHILE:
+    {
+        // Only facts, which hold on every iteration, are used in the loop
+        kill_changed_vars(state, stmt);
+        if (calls_program_function(stmt, state->defs))
+            kill_globals(state);
+
+        rewrite_expr(&stmt->left, state);
+        value_fact* facts = copy_facts(state->facts);
+        propagate_in_stmt(&stmt->right, state);
+
+        free_facts(state->facts);
+        state->facts = facts;
+        state->is_reachable = true;
+        return;
+    }
+
+    case NODE_DEFS: case NODE_NFUN: case NODE_ARG: case NODE_SEQ:
+    case NODE_BRANCH: case NODE_PAR: case NODE_OP: case NODE_CMP:
+    case NODE_LOGIC: case NODE_VAR: case NODE_CONST:
+    default:
+        return;
+    }
+}
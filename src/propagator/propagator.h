@@ -0,0 +1,32 @@
+/**
+ * @file propagator.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief AST-level constant and copy propagation with value numbering
+ *
+ * @version 0.1
+ * @date 2023-06-01
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __PROPAGATOR_PROPAGATOR_H
+#define __PROPAGATOR_PROPAGATOR_H
+
+#include "data_structures/ast/ast.h"
+
+/**
+ * @brief Replace uses of variables holding integer constants or copies of
+ * other variables with these values, and replace expressions, which were
+ * already computed into a variable, with this variable. Expressions
+ * computed more than once in the same block are evaluated into a new
+ * variable declared before their first use. Facts about variables flow
+ * forward through function bodies: branches keep facts true on both paths,
+ * and loops keep facts about variables, which they do not change.
+ *
+ * @param[inout] tree   Program AST
+ *
+ * @return `true` on success, `false` otherwise
+ */
+bool propagate_values(abstract_syntax_tree* tree);
+
+#endif /* propagator.h */
@@ -120,8 +120,9 @@ static bool collapse_const(ast_node* node)
     case OP_SUB: COMBINE_CHILDREN(-); break;
     case OP_MUL: COMBINE_CHILDREN(*); break;
     case OP_DIV:
-        LOG_ASSERT_ERROR(!num_cmp(LEFT, 0), return false, "Division by zero", NULL);
-        COMBINE_CHILDREN(/);
+        // Division by zero is left for runtime, as it may never be executed
+        if (!is_zero(RIGHT))
+            COMBINE_CHILDREN(/);
         break;
     default:
         break;
@@ -269,7 +270,6 @@ static bool extract_right_zero(ast_node* node)
 {
     LOG_ASSERT(is_op(node), return false);
     LOG_ASSERT(is_zero(RIGHT), return false);
-    LOG_ASSERT_ERROR(!op_cmp(node, OP_DIV), return false, "Division by zero", NULL);
 
     switch (get_op(node))
     {
@@ -1,12 +1,17 @@
+#include <string.h>
+#include <stdio.h>
+
 #include "util/logger/logger.h"
 
 #include "back_flags.h"
+#include "back_utils.h"
 
 int back_set_input_file(const char *const *argv, void *params)
 {
     arg_state* state = (arg_state*)params;
 
-    LOG_ASSERT_ERROR(state->input_filename == NULL, return -1,
+    LOG_ASSERT_ERROR(state->input_filename == NULL,
+            { state->had_error = true; return -1; },
             "Attempted to redefine input file '%s' to '%s'", state->input_filename);
 
     state->input_filename = *argv;
@@ -18,7 +23,8 @@ int back_set_output_file(const char *const *argv, void *params)
 {
     arg_state* state = (arg_state*)params;
 
-    LOG_ASSERT_ERROR(state->output_filename == NULL, return -1,
+    LOG_ASSERT_ERROR(state->output_filename == NULL,
+            { state->had_error = true; return -1; },
             "Attempted to redefine output file '%s' to '%s'", state->output_filename);
 
     state->output_filename = *argv;
@@ -33,6 +39,88 @@ int back_set_no_stdlib(const char *const *, void *params)
     return 0;
 }
 
+int back_set_peephole_stats(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->show_peephole_stats = true;
+    return 0;
+}
+
+int back_set_float(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->use_double = true;
+    return 0;
+}
+
+int back_set_unbuffered(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->unbuffered_output = true;
+    return 0;
+}
+
+int back_set_fixed_scale(const char *const *argv, void *params)
+{
+    arg_state* state = (arg_state*)params;
+
+    LOG_ASSERT_ERROR(*argv != NULL,
+            { state->had_error = true; return -1; },
+            "Expected fixed-point scale after '--fixed-scale'", NULL);
+
+    if (strcmp(*argv, "dec") == 0)
+    {
+        state->fixed_pow2 = false;
+        return 1;
+    }
+
+    unsigned shift = 0;
+    int parsed = 0;
+    int matched = sscanf(*argv, "pow2:%u%n", &shift, &parsed);
+    LOG_ASSERT_ERROR(matched == 1 && (*argv)[parsed] == '\0'
+                        && 1 <= shift && shift <= FIXED_SHIFT_MAX,
+            { state->had_error = true; return -1; },
+            "Invalid fixed-point scale '%s'", *argv);
+
+    state->fixed_pow2  = true;
+    state->fixed_shift = shift;
+    return 1;
+}
+
+static int parse_alignment(const char* const* argv, const char* tag,
+                           size_t* alignment)
+{
+    LOG_ASSERT_ERROR(*argv != NULL, return -1,
+            "Expected alignment after '%s'", tag);
+
+    size_t value = 0;
+    int parsed = 0;
+    int matched = sscanf(*argv, "%zu%n", &value, &parsed);
+    LOG_ASSERT_ERROR(matched == 1 && (*argv)[parsed] == '\0'
+                        && (value == 1 || value == 16
+                            || value == 32 || value == 64), return -1,
+            "Invalid alignment '%s'", *argv);
+
+    *alignment = value;
+    return 1;
+}
+
+int back_set_loop_align(const char *const *argv, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    int parsed = parse_alignment(argv, "--align-loops", &state->loop_align);
+    state->had_error |= parsed < 0;
+    return parsed;
+}
+
+int back_set_func_align(const char *const *argv, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    int parsed = parse_alignment(argv, "--align-functions", &state->func_align);
+    state->had_error |= parsed < 0;
+    return parsed;
+}
+
 int back_show_help(const char *const *, void *params)
 {
     arg_state* state = (arg_state*)params;
@@ -40,3 +128,25 @@ int back_show_help(const char *const *, void *params)
     state->help_shown = true;
     return 0;
 }
+
+int back_set_march(const char *const *argv, void *params)
+{
+    arg_state* state = (arg_state*)params;
+
+    LOG_ASSERT_ERROR(*argv != NULL,
+            { state->had_error = true; return -1; },
+            "Expected target after '--march'", NULL);
+
+    if      (strcmp(*argv, "sse2")   == 0) state->target = TARGET_SSE2;
+    else if (strcmp(*argv, "avx2")   == 0) state->target = TARGET_AVX2;
+    else if (strcmp(*argv, "avx512") == 0) state->target = TARGET_AVX2;
+    else if (strcmp(*argv, "native") == 0) state->target = detect_host_target();
+    else
+    {
+        LOG_ASSERT_ERROR(false,
+                { state->had_error = true; return -1; },
+                "Invalid target '%s'", *argv);
+    }
+
+    return 1;
+}
@@ -2,18 +2,35 @@
 #define BACK_FLAGS
 
 #include "meerkat_args/argparser.h"
+#include "compiler/compiler.h"
 
 struct arg_state
 {
     const char* input_filename;
     const char* output_filename;
     bool no_stdlib;
+    bool show_peephole_stats;
+    bool fixed_pow2;
+    unsigned fixed_shift;
+    bool use_double;
+    bool unbuffered_output;
+    size_t loop_align;
+    size_t func_align;
+    compiler_target target;
     bool help_shown;
+    bool had_error;
 };
 
 int back_set_input_file(const char* const* argv, void* params);
 int back_set_output_file(const char* const* argv, void* params);
 int back_set_no_stdlib(const char* const* argv, void* params);
+int back_set_peephole_stats(const char* const* argv, void* params);
+int back_set_fixed_scale(const char* const* argv, void* params);
+int back_set_float(const char* const* argv, void* params);
+int back_set_unbuffered(const char* const* argv, void* params);
+int back_set_loop_align(const char* const* argv, void* params);
+int back_set_func_align(const char* const* argv, void* params);
+int back_set_march(const char* const* argv, void* params);
 int back_show_help(const char* const* argv, void* params);
 
 const arg_tag BACK_TAGS[] = {
@@ -29,6 +46,59 @@ const arg_tag BACK_TAGS[] = {
         .callback = back_set_no_stdlib,
         .description = "Do not allow standard library functions."
     },
+    {
+        .short_tag = '\0',
+        .long_tag = "peephole-stats",
+        .callback = back_set_peephole_stats,
+        .description = "Print number of applied peephole optimizations."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "fixed-scale",
+        .callback = back_set_fixed_scale,
+        .description = "Set fixed-point number scale: \033[3m" "dec" "\033[23m "
+                       "(1000, default) or \033[3m" "pow2:N" "\033[23m "
+                       "(2^N, 1 <= N <= 16)."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "float",
+        .callback = back_set_float,
+        .description = "Use native double-precision numbers instead of "
+                       "fixed-point ones."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "unbuffered-output",
+        .callback = back_set_unbuffered,
+        .description = "Write output of every \033[3m" "print" "\033[23m "
+                       "immediately instead of buffering it until exit. "
+                       "Useful for interactive programs."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "align-loops",
+        .callback = back_set_loop_align,
+        .description = "Align loop headers to \033[3m" "N" "\033[23m bytes: "
+                       "1 (no alignment), 16 (default), 32 or 64."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "align-functions",
+        .callback = back_set_func_align,
+        .description = "Align function entries to \033[3m" "N" "\033[23m "
+                       "bytes: 1 (no alignment), 16 (default), 32 or 64."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "march",
+        .callback = back_set_march,
+        .description = "Set instruction set of generated code: "
+                       "\033[3m" "sse2" "\033[23m (default), "
+                       "\033[3m" "avx2" "\033[23m (alias "
+                       "\033[3m" "avx512" "\033[23m) or "
+                       "\033[3m" "native" "\033[23m (detect host CPU)."
+    },
     {
         .short_tag = 'h',
         .long_tag = "help",
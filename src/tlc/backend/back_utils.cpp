@@ -1,5 +1,7 @@
+#include <cpuid.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "util/logger/logger.h"
 
@@ -7,6 +9,66 @@
 
 #include "back_utils.h"
 
+char** split_tag_values(int* argc, const char* const* argv)
+{
+    char** result = (char**) calloc(2 * (size_t) *argc + 1, sizeof(*result));
+    int result_cnt = 0;
+
+    for (int i = 0; i < *argc; ++i)
+    {
+        const char* value = strchr(argv[i], '=');
+        if (strncmp(argv[i], "--", 2) != 0 || value == NULL)
+        {
+            result[result_cnt++] = strdup(argv[i]);
+            continue;
+        }
+
+        result[result_cnt++] = strndup(argv[i], (size_t) (value - argv[i]));
+        result[result_cnt++] = strdup(value + 1);
+    }
+
+    *argc = result_cnt;
+    return result;
+}
+
+void free_args(int argc, char** argv)
+{
+    for (int i = 0; i < argc; ++i)
+        free(argv[i]);
+    free(argv);
+}
+
+static unsigned long long read_xcr0(void)
+{
+    unsigned eax = 0, edx = 0;
+    asm volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+}
+
+compiler_target detect_host_target(void)
+{
+    const unsigned ECX_OSXSAVE  = 1u << 27;
+    const unsigned ECX_AVX      = 1u << 28;
+    const unsigned EBX_AVX2     = 1u << 5;
+    const unsigned long long XCR0_YMM = 0x06;   // SSE and AVX state
+
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return TARGET_SSE2;
+    if ((ecx & (ECX_OSXSAVE | ECX_AVX)) != (ECX_OSXSAVE | ECX_AVX))
+        return TARGET_SSE2;
+
+    unsigned long long xcr0 = read_xcr0();
+    if ((xcr0 & XCR0_YMM) != XCR0_YMM)
+        return TARGET_SSE2;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+        || !(ebx & EBX_AVX2))
+        return TARGET_SSE2;
+
+    return TARGET_AVX2;
+}
+
 bool get_tree_from_file(const char *filename, abstract_syntax_tree *tree)
 {
     LOG_ASSERT_ERROR(filename, return false, "Input file not specified.", NULL);
@@ -21,7 +83,8 @@ bool get_tree_from_file(const char *filename, abstract_syntax_tree *tree)
     return true;
 }
 
-bool compile_tree_to_file(const abstract_syntax_tree *tree, const char *filename, bool use_stdlib)
+bool compile_tree_to_file(const abstract_syntax_tree *tree, const char *filename,
+                          const compiler_options* options)
 {
     LOG_ASSERT(tree, return false);
     if (!filename) filename = BACK_DEFAULT_OUTPUT;
@@ -29,7 +92,7 @@ bool compile_tree_to_file(const abstract_syntax_tree *tree, const char *filename
     LOG_ASSERT_ERROR(output, return false,
         "Failed to open file '%s': %s", filename, strerror(errno));
 
-    bool success = compiler_tree_to_asm(tree, output, use_stdlib);
+    bool success = compiler_tree_to_asm(tree, output, options);
     fclose(output);
 
     LOG_ASSERT(success, return false);
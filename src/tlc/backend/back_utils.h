@@ -2,12 +2,32 @@
 #define BACK_UTILS
 
 #include "data_structures/ast/ast.h"
+#include "compiler/compiler.h"
 
 const char BACK_DEFAULT_OUTPUT[] = "out.asm";
+const size_t BACK_DEFAULT_ALIGN = 16;
+
+/**
+ * @brief Split every `--tag=value` argument into `--tag` and `value`
+ * @param[inout] argc   Argument count
+ * @param[in]    argv   Argument vector
+ * @return Newly allocated argument vector (free with `free_args()`)
+ */
+char** split_tag_values(int* argc, const char* const* argv);
+
+/**
+ * @brief Free argument vector created by `split_tag_values()`
+ */
+void free_args(int argc, char** argv);
+
+/**
+ * @brief Find best code generation target supported by host CPU and OS
+ */
+compiler_target detect_host_target(void);
 
 bool get_tree_from_file(const char* filename, abstract_syntax_tree* tree);
 bool compile_tree_to_file(const abstract_syntax_tree* tree,
                           const char* filename,
-                          bool use_stdlib = true);
+                          const compiler_options* options);
 
 #endif
\ No newline at end of file
@@ -18,26 +18,47 @@ int main(int argc, char** argv)
         .settings_mask = LGS_USE_ESCAPE | LGS_KEEP_OPEN
     });
 
+    int    args_cnt = argc;
+    char** args     = split_tag_values(&args_cnt, argv);
+
     arg_state state = {};
     STEP(
-        parse_args(argc, argv, &BACK_ARG_INFO, &state),
-        {}
+        parse_args(args_cnt, args, &BACK_ARG_INFO, &state) >= 0
+            && !state.had_error,
+        free_args(args_cnt, args)
     );
 
-    if (state.help_shown) return 0;
+    if (state.help_shown)
+    {
+        free_args(args_cnt, args);
+        return 0;
+    }
 
     abstract_syntax_tree tree = {};
 
     STEP(
         get_tree_from_file(state.input_filename, &tree),
-        {}
+        free_args(args_cnt, args)
     );
+    compiler_options options = {
+        .use_stdlib = !state.no_stdlib,
+        .show_peephole_stats = state.show_peephole_stats,
+        .fixed_pow2 = state.fixed_pow2,
+        .fixed_shift = state.fixed_shift,
+        .use_double = state.use_double,
+        .unbuffered_output = state.unbuffered_output,
+        .func_align = state.func_align ? state.func_align : BACK_DEFAULT_ALIGN,
+        .loop_align = state.loop_align ? state.loop_align : BACK_DEFAULT_ALIGN,
+        .target = state.target
+    };
+
     STEP(
-        compile_tree_to_file(&tree, state.output_filename, !state.no_stdlib),
-        tree_dtor(&tree)
+        compile_tree_to_file(&tree, state.output_filename, &options),
+        { tree_dtor(&tree); free_args(args_cnt, args); }
     );
 
     tree_dtor(&tree);
+    free_args(args_cnt, args);
 
     return 0;
 }
\ No newline at end of file
@@ -19,7 +19,8 @@ int main(int argc, char** argv)
 
     arg_state state = {};
     STEP(
-        parse_args(argc, argv, &MID_ARG_INFO, &state), {}
+        parse_args(argc, argv, &MID_ARG_INFO, &state) >= 0
+            && !state.had_error, {}
     );
 
     if (state.help_shown) return 0;
@@ -31,6 +32,42 @@ int main(int argc, char** argv)
     STEP(
         try_simplify_tree(&tree), tree_dtor(&tree)
     );
+    if (!state.no_inline)
+    {
+        STEP(
+            try_inline_functions(&tree), tree_dtor(&tree)
+        );
+        STEP(   // Fold substituted constant arguments
+            try_simplify_tree(&tree), tree_dtor(&tree)
+        );
+    }
+    if (!state.no_propagate)
+    {
+        STEP(
+            try_propagate_values(&tree), tree_dtor(&tree)
+        );
+        STEP(   // Fold propagated constants
+            try_simplify_tree(&tree), tree_dtor(&tree)
+        );
+    }
+    if (!state.no_licm)
+    {
+        STEP(
+            try_hoist_loop_invariants(&tree), tree_dtor(&tree)
+        );
+    }
+    if (!state.no_reduce_iv)
+    {
+        STEP(
+            try_reduce_induction_vars(&tree), tree_dtor(&tree)
+        );
+    }
+    if (!state.no_unroll)
+    {
+        STEP(
+            try_unroll_loops(&tree, state.unroll_factor), tree_dtor(&tree)
+        );
+    }
     STEP(
         write_tree_to_file(&tree, state.output_filename), tree_dtor(&tree)
     );
@@ -1,3 +1,5 @@
+#include <stdio.h>
+
 #include "util/logger/logger.h"
 
 #include "mid_flags.h"
@@ -6,7 +8,8 @@ int mid_set_input_file(const char *const *argv, void *params)
 {
     arg_state* state = (arg_state*)params;
 
-    LOG_ASSERT_ERROR(state->input_filename == NULL, return -1,
+    LOG_ASSERT_ERROR(state->input_filename == NULL,
+            { state->had_error = true; return -1; },
             "Attempted to redefine input file '%s' to '%s'", state->input_filename);
 
     state->input_filename = *argv;
@@ -18,7 +21,8 @@ int mid_set_output_file(const char *const *argv, void *params)
 {
     arg_state* state = (arg_state*)params;
 
-    LOG_ASSERT_ERROR(state->output_filename == NULL, return -1,
+    LOG_ASSERT_ERROR(state->output_filename == NULL,
+            { state->had_error = true; return -1; },
             "Attempted to redefine output file '%s' to '%s'", state->output_filename);
 
     state->output_filename = *argv;
@@ -26,6 +30,61 @@ int mid_set_output_file(const char *const *argv, void *params)
     return 1;
 }
 
+int mid_set_no_inline(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->no_inline = true;
+    return 0;
+}
+
+int mid_set_no_propagate(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->no_propagate = true;
+    return 0;
+}
+
+int mid_set_no_licm(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->no_licm = true;
+    return 0;
+}
+
+int mid_set_no_reduce_iv(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->no_reduce_iv = true;
+    return 0;
+}
+
+int mid_set_no_unroll(const char *const *, void *params)
+{
+    arg_state* state = (arg_state*)params;
+    state->no_unroll = true;
+    return 0;
+}
+
+int mid_set_unroll(const char *const *argv, void *params)
+{
+    arg_state* state = (arg_state*)params;
+
+    LOG_ASSERT_ERROR(*argv != NULL,
+            { state->had_error = true; return -1; },
+            "Expected unroll factor after '--unroll'", NULL);
+
+    unsigned factor = 0;
+    int parsed = 0;
+    int matched = sscanf(*argv, "%u%n", &factor, &parsed);
+    LOG_ASSERT_ERROR(matched == 1 && (*argv)[parsed] == '\0'
+                        && 1 <= factor && factor <= 16,
+            { state->had_error = true; return -1; },
+            "Invalid unroll factor '%s'", *argv);
+
+    state->unroll_factor = factor;
+    return 1;
+}
+
 int mid_show_help(const char *const *, void *params)
 {
     arg_state* state = (arg_state*)params;
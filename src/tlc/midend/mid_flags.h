@@ -7,11 +7,24 @@ struct arg_state
 {
     const char* input_filename;
     const char* output_filename;
+    bool no_inline;
+    bool no_propagate;
+    bool no_licm;
+    bool no_reduce_iv;
+    bool no_unroll;
+    unsigned unroll_factor;
     bool help_shown;
+    bool had_error;
 };
 
 int mid_set_input_file(const char* const* argv, void* params);
 int mid_set_output_file(const char* const* argv, void* params);
+int mid_set_no_inline(const char* const* argv, void* params);
+int mid_set_no_propagate(const char* const* argv, void* params);
+int mid_set_no_licm(const char* const* argv, void* params);
+int mid_set_no_reduce_iv(const char* const* argv, void* params);
+int mid_set_no_unroll(const char* const* argv, void* params);
+int mid_set_unroll(const char* const* argv, void* params);
 int mid_show_help(const char* const* argv, void* params);
 
 const arg_tag MID_TAGS[] = {
@@ -21,6 +34,45 @@ const arg_tag MID_TAGS[] = {
         .callback = mid_set_output_file,
         .description = "Set output file. Default output file is \033[3m" "out.asm" "\033[23m."
     },
+    {
+        .short_tag = '\0',
+        .long_tag = "no-inline",
+        .callback = mid_set_no_inline,
+        .description = "Do not inline function calls."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "no-propagate",
+        .callback = mid_set_no_propagate,
+        .description = "Do not propagate constants and copies of variables "
+                       "or reuse already computed expressions."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "no-licm",
+        .callback = mid_set_no_licm,
+        .description = "Do not move loop-invariant expressions out of loops."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "no-reduce-iv",
+        .callback = mid_set_no_reduce_iv,
+        .description = "Do not replace products of loop counters "
+                       "with additions."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "no-unroll",
+        .callback = mid_set_no_unroll,
+        .description = "Do not unroll loops."
+    },
+    {
+        .short_tag = '\0',
+        .long_tag = "unroll",
+        .callback = mid_set_unroll,
+        .description = "Set number of body copies in unrolled loops "
+                       "(1 to 16, default is 4)."
+    },
     {
         .short_tag = 'h',
         .long_tag = "help",
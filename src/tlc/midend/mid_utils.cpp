@@ -5,6 +5,9 @@
 #include "util/logger/logger.h"
 
 #include "simplifier/simplifier.h"
+#include "inliner/inliner.h"
+#include "propagator/propagator.h"
+#include "loop_optimizer/loop_optimizer.h"
 
 #include "mid_utils.h"
 
@@ -29,6 +32,44 @@ bool try_simplify_tree(abstract_syntax_tree *tree)
     return true;
 }
 
+bool try_inline_functions(abstract_syntax_tree *tree)
+{
+    LOG_ASSERT_ERROR(inline_functions(tree), return false, "Failed to inline functions.", NULL);
+
+    return true;
+}
+
+bool try_propagate_values(abstract_syntax_tree *tree)
+{
+    LOG_ASSERT_ERROR(propagate_values(tree), return false, "Failed to propagate values.", NULL);
+
+    return true;
+}
+
+bool try_hoist_loop_invariants(abstract_syntax_tree *tree)
+{
+    LOG_ASSERT_ERROR(hoist_loop_invariants(tree), return false, "Failed to optimize loops.", NULL);
+
+    return true;
+}
+
+bool try_reduce_induction_vars(abstract_syntax_tree *tree)
+{
+    LOG_ASSERT_ERROR(reduce_induction_vars(tree), return false, "Failed to reduce induction variables.", NULL);
+
+    return true;
+}
+
+bool try_unroll_loops(abstract_syntax_tree *tree, unsigned factor)
+{
+    if (!factor) factor = MID_DEFAULT_UNROLL;
+    if (factor == 1) return true;
+
+    LOG_ASSERT_ERROR(unroll_loops(tree, factor), return false, "Failed to unroll loops.", NULL);
+
+    return true;
+}
+
 bool write_tree_to_file(const abstract_syntax_tree *tree, const char *filename)
 {
     LOG_ASSERT(tree, return false);
@@ -4,9 +4,15 @@
 #include "data_structures/ast/ast.h"
 
 const char MID_DEFAULT_OUTPUT[] = "out-opt.ast";
+const unsigned MID_DEFAULT_UNROLL = 4;
 
 bool input_tree_from_file(const char* filename, abstract_syntax_tree* tree);
 bool try_simplify_tree(abstract_syntax_tree* tree);
+bool try_inline_functions(abstract_syntax_tree* tree);
+bool try_propagate_values(abstract_syntax_tree* tree);
+bool try_hoist_loop_invariants(abstract_syntax_tree* tree);
+bool try_reduce_induction_vars(abstract_syntax_tree* tree);
+bool try_unroll_loops(abstract_syntax_tree* tree, unsigned factor);
 bool write_tree_to_file(const abstract_syntax_tree* tree, const char* filename);
 
 
@@ -2,6 +2,7 @@
 
 #include "test_utils/config.h"
 #include "test_cases/benchmark.h"
+#include "test_cases/regression.h"
 
 int main(int argc, char** argv)
 {
@@ -21,6 +22,8 @@ int main(int argc, char** argv)
     {
     case TEST_BENCHMARK_FULL:
         return run_test_benchmark(argc, argv, &config);
+    case TEST_REGRESSION:
+        return run_test_regression(argc, argv, &config);
     case TEST_NONE:
     default:
         fprintf(stderr, "Invalid test case");
@@ -0,0 +1,279 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "regression.h"
+
+static const size_t PATH_LEN = 512;
+
+/* Compiled program is killed if it runs longer than this */
+static const unsigned RUN_TIMEOUT_SEC = 10;
+
+/* Every program is compiled with each of these sets of mid-end flags */
+static const char* const MIDEND_FLAGS[][6] = {
+    { NULL },
+    { "--unroll", "2", NULL },
+    { "--no-inline", "--no-propagate", "--no-licm", "--no-reduce-iv",
+      "--no-unroll", NULL }
+};
+
+static const size_t MIDEND_FLAG_SETS = sizeof(MIDEND_FLAGS)
+                                     / sizeof(*MIDEND_FLAGS);
+
+/* ...and then with each of these sets of backend flags */
+static const char* const BACKEND_FLAGS[][3] = {
+    { NULL },
+    { "--fixed-scale", "pow2:16", NULL },
+    { "--float", NULL }
+};
+
+static const size_t BACKEND_FLAG_SETS = sizeof(BACKEND_FLAGS)
+                                      / sizeof(*BACKEND_FLAGS);
+
+struct RegressionDirs
+{
+    const char* bin_dir;
+    const char* test_dir;
+    char        work_dir[PATH_LEN];
+};
+
+
+static int compare_names(const void* lhs, const void* rhs);
+
+static size_t list_programs(const char* test_dir, char*** names);
+
+static bool run_program(const RegressionDirs* dirs, const char* name,
+                        size_t mid_set, size_t back_set);
+
+static int run_command(const char* const* argv,
+                       const char* in_file, const char* out_file);
+
+static bool files_equal(const char* lhs, const char* rhs);
+
+
+int run_test_regression(int argc, const char* const* argv,
+                        const TestConfig* config)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Error: expected compiler binary directory "
+                        "and test directory\n");
+        return 1;
+    }
+
+    FILE* output = stdout;
+    if (config->filename)
+        output = fopen(config->filename, config->append_to_file ? "a" : "w");
+    if (!output)
+    {
+        perror("Failed to open output file");
+        return 1;
+    }
+
+    RegressionDirs dirs = {
+        .bin_dir  = argv[1],
+        .test_dir = argv[2],
+        .work_dir = "/tmp/tlc_regressionXXXXXX"
+    };
+    if (!mkdtemp(dirs.work_dir))
+    {
+        perror("Failed to create working directory");
+        if (output != stdout) fclose(output);
+        return 1;
+    }
+
+    char** names = NULL;
+    size_t name_cnt = list_programs(dirs.test_dir, &names);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < name_cnt; ++i)
+    {
+        bool passed = true;
+        for (size_t j = 0; j < MIDEND_FLAG_SETS && passed; ++j)
+            for (size_t k = 0; k < BACKEND_FLAG_SETS && passed; ++k)
+                passed = run_program(&dirs, names[i], j, k);
+
+        fprintf(output, "%s %s\n", passed ? "PASS" : "FAIL", names[i]);
+        failed += !passed;
+        free(names[i]);
+    }
+    free(names);
+
+    char command[PATH_LEN] = "";
+    snprintf(command, PATH_LEN, "rm -rf '%s'", dirs.work_dir);
+    if (system(command) != 0)
+        fprintf(stderr, "Warning: failed to remove '%s'\n", dirs.work_dir);
+
+    fprintf(output, "\n%zu/%zu programs passed\n", name_cnt - failed, name_cnt);
+    if (output != stdout) fclose(output);
+
+    return failed == 0 && name_cnt > 0 ? 0 : 1;
+}
+
+static int compare_names(const void* lhs, const void* rhs)
+{
+    return strcmp(*(const char* const*) lhs, *(const char* const*) rhs);
+}
+
+/* Find names of all '*.tyl' files in directory, without extension */
+static size_t list_programs(const char* test_dir, char*** names)
+{
+    DIR* dir = opendir(test_dir);
+    if (!dir)
+    {
+        perror("Failed to open test directory");
+        return 0;
+    }
+
+    size_t count = 0, capacity = 0;
+    for (dirent* entry = readdir(dir); entry; entry = readdir(dir))
+    {
+        size_t len = strlen(entry->d_name);
+        if (len <= 4 || strcmp(entry->d_name + len - 4, ".tyl") != 0)
+            continue;
+
+        if (count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 16;
+            *names = (char**) realloc(*names, capacity * sizeof(**names));
+        }
+        (*names)[count++] = strndup(entry->d_name, len - 4);
+    }
+    closedir(dir);
+
+    qsort(*names, count, sizeof(**names), compare_names);
+    return count;
+}
+
+/* Compile program with selected mid-end and backend flags and check
+ * its output */
+static bool run_program(const RegressionDirs* dirs, const char* name,
+                        size_t mid_set, size_t back_set)
+{
+    char frontend[PATH_LEN] = "", midend[PATH_LEN] = "", backend[PATH_LEN] = "";
+    snprintf(frontend, PATH_LEN, "%s/tlc_frontend", dirs->bin_dir);
+    snprintf(midend,   PATH_LEN, "%s/tlc_midend",   dirs->bin_dir);
+    snprintf(backend,  PATH_LEN, "%s/tlc_backend",  dirs->bin_dir);
+
+    char source[PATH_LEN] = "", input[PATH_LEN] = "", expected[PATH_LEN] = "";
+    snprintf(source,   PATH_LEN, "%s/%s.tyl", dirs->test_dir, name);
+    snprintf(input,    PATH_LEN, "%s/%s.in",  dirs->test_dir, name);
+    snprintf(expected, PATH_LEN, "%s/%s.out", dirs->test_dir, name);
+
+    char ast[PATH_LEN] = "", opt[PATH_LEN] = "", exe[PATH_LEN] = "";
+    char output[PATH_LEN] = "";
+    snprintf(ast,    PATH_LEN, "%s/%s.ast",     dirs->work_dir, name);
+    snprintf(opt,    PATH_LEN, "%s/%s-opt.ast", dirs->work_dir, name);
+    snprintf(exe,    PATH_LEN, "%s/%s",         dirs->work_dir, name);
+    snprintf(output, PATH_LEN, "%s/%s.txt",     dirs->work_dir, name);
+
+    const char* front_argv[] = { frontend, source, "-o", ast, NULL };
+    const char* exe_argv[]   = { exe, NULL };
+
+    const char* mid_argv[10] = { midend, ast, "-o", opt };
+    for (size_t i = 0; MIDEND_FLAGS[mid_set][i]; ++i)
+        mid_argv[4 + i] = MIDEND_FLAGS[mid_set][i];
+
+    const char* back_argv[8] = { backend, opt, "-o", exe };
+    for (size_t i = 0; BACKEND_FLAGS[back_set][i]; ++i)
+        back_argv[4 + i] = BACKEND_FLAGS[back_set][i];
+
+    const char* failure = NULL;
+    int status = 0;
+    if (run_command(front_argv, NULL, NULL) != 0)
+        failure = "frontend failed";
+    else if (run_command(mid_argv, NULL, NULL) != 0)
+        failure = "mid-end failed";
+    else if (run_command(back_argv, NULL, NULL) != 0 || chmod(exe, 0755) != 0)
+        failure = "backend failed";
+    else if ((status = run_command(exe_argv,
+                                   access(input, R_OK) == 0 ? input : NULL,
+                                   output)) != 0)
+        failure = "program exited with non-zero status";
+    else if (!files_equal(output, expected))
+        failure = "unexpected output";
+
+    if (!failure)
+        return true;
+
+    fprintf(stderr, "%s (mid-end flags:", name);
+    for (size_t i = 0; MIDEND_FLAGS[mid_set][i]; ++i)
+        fprintf(stderr, " %s", MIDEND_FLAGS[mid_set][i]);
+    fprintf(stderr, "; backend flags:");
+    for (size_t i = 0; BACKEND_FLAGS[back_set][i]; ++i)
+        fprintf(stderr, " %s", BACKEND_FLAGS[back_set][i]);
+    fprintf(stderr, "): %s", failure);
+    if (status != 0)
+        fprintf(stderr, " (%d)", status);
+    fputc('\n', stderr);
+    return false;
+}
+
+/* Run command with redirected input and output, return its exit status
+ * or 128 + signal number, if it was killed */
+static int run_command(const char* const* argv,
+                       const char* in_file, const char* out_file)
+{
+    pid_t child = fork();
+    if (child < 0)
+    {
+        perror("Failed to spawn process");
+        return -1;
+    }
+
+    if (child == 0)
+    {
+        int in_fd  = open(in_file ? in_file : "/dev/null", O_RDONLY);
+        int out_fd = out_file ? open(out_file, O_WRONLY | O_CREAT | O_TRUNC,
+                                     0644)
+                              : open("/dev/null", O_WRONLY);
+        int err_fd = open("/dev/null", O_WRONLY);
+        if (in_fd < 0 || out_fd < 0 || err_fd < 0)
+            _exit(127);
+
+        dup2(in_fd,  STDIN_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+        dup2(err_fd, STDERR_FILENO);
+        alarm(RUN_TIMEOUT_SEC);     // Pending alarm survives exec
+
+        execv(argv[0], const_cast<char* const*>(argv));
+        _exit(127);
+    }
+
+    int status = 0;
+    if (waitpid(child, &status, 0) < 0)
+    {
+        perror("Failed to wait for child");
+        return -1;
+    }
+
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+
+static bool files_equal(const char* lhs, const char* rhs)
+{
+    FILE* lhs_file = fopen(lhs, "rb");
+    FILE* rhs_file = fopen(rhs, "rb");
+
+    bool equal = lhs_file && rhs_file;
+    while (equal)
+    {
+        int lhs_char = fgetc(lhs_file);
+        int rhs_char = fgetc(rhs_file);
+        equal = lhs_char == rhs_char;
+        if (lhs_char == EOF)
+            break;
+    }
+
+    if (lhs_file) fclose(lhs_file);
+    if (rhs_file) fclose(rhs_file);
+    return equal;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file regression.h
+ * @author MeerkatBoss (solodovnikov.ia@phystech.edu)
+ *
+ * @brief
+ *
+ * @version 0.1
+ * @date 2023-06-05
+ *
+ * @copyright Copyright MeerkatBoss (c) 2023
+ */
+#ifndef __TESTS_TEST_CASES_REGRESSION_H
+#define __TESTS_TEST_CASES_REGRESSION_H
+
+#include "test_utils/config.h"
+
+/**
+ * @brief Compile every program `<name>.tyl` from test directory with
+ * several sets of mid-end and backend flags, run it with input from
+ * `<name>.in` (if it exists) and compare its output with `<name>.out`.
+ * Programs must exit with zero status.
+ *
+ * @param[in] argc	    - Argument vector length
+ * @param[in] argv	    - Argument vector: directory with compiler binaries
+ *                        and directory with test programs
+ * @param[in] config	- Test configuration
+ *
+ * @return Exit status
+ */
+int run_test_regression(int argc, const char* const* argv,
+                        const TestConfig* config);
+
+#endif /* regression.h */
@@ -33,6 +33,12 @@ int test_select_test_case(const char* const* str, void* params)
         return 1;
     }
 
+    if (strcasecmp(test_name, "regression") == 0)
+    {
+        config->test_case = TEST_REGRESSION;
+        return 1;
+    }
+
     fprintf(stderr, "Error: unknown test case '%s'\n", test_name);
     config->had_error = 1;
     return -1;
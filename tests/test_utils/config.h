@@ -19,7 +19,8 @@
 enum TestCase
 {
     TEST_NONE,
-    TEST_BENCHMARK_FULL
+    TEST_BENCHMARK_FULL,
+    TEST_REGRESSION
 };
 
 struct TestConfig